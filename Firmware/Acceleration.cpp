@@ -1,29 +1,40 @@
 // https://github.com/apple-oss-distributions/IOHIDFamily/blob/c56e1c1b2469d9956a585cc2518c8f0c51b5809d/IOHIDSystem/IOHIPointing.cpp
 
-#include <Arduino.h>
-#include <SPI.h>
-
 #include <math.h>
 #include <string.h>
 
+#include "Hal.h"
 #include "RingBuffer.h"
 #include "Acceleration.h"
 
 
-Offsets MouseAcceleration::update(double dx, double dy, unsigned long timestampMs, bool clear) {
-  addEvent(dx, dy, timestampMs, clear);
+Offsets MouseAcceleration::update(double dx, double dy, uint64_t timestampMus, bool clear) {
+  addEvent(dx, dy, timestampMus, clear);
+  auto avg = calcAverages();
+  return calcScroll(avg);
+}
+
+Offsets MouseAcceleration::update(double dx, double dy, uint64_t sinceMus, uint64_t timestampMus) {
+  addEvent(dx, dy, timestampMus);
+  if (timestampMus > sinceMus) {
+    events.back().timeDeltaMs = static_cast<double>(timestampMus - sinceMus) / 1000.0;
+  }
   auto avg = calcAverages();
   return calcScroll(avg);
 }
 
-void MouseAcceleration::addEvent(double dx, double dy, unsigned long timestampMs, bool clear) {
-  unsigned long timeDeltaMs = events.empty() ? 0 : max(timestampMs - events.back().timestampMs, 0UL);
+void MouseAcceleration::addEvent(double dx, double dy, uint64_t timestampMus, bool clear) {
+  double timeDeltaMs = 0.0;
+  if (!events.empty() && timestampMus > events.back().timestampMus) {
+    timeDeltaMs = static_cast<double>(timestampMus - events.back().timestampMus) / 1000.0;
+  }
+
   if (timeDeltaMs >= eventClearThresholdMs || clear) {
     events.clear();
     timeDeltaMs = eventClearThresholdMs;
   }
 
-  events.emplace_back(dx, dy, timestampMs, timeDeltaMs);
+  events.emplace_back(dx, dy, timestampMus, timeDeltaMs);
 }
 
 MouseAcceleration::MoveAverage MouseAcceleration::calcAverages() const {
@@ -1,6 +1,9 @@
 #ifndef ACCELERATION_H22659411
 #define ACCELERATION_H22659411
 
+#include <math.h>
+#include <stdint.h>
+
 #include "RingBuffer.h"
 
 
@@ -32,13 +35,13 @@ protected:
     double dx = 0.0;
     double dy = 0.0;
 
-    unsigned long timestampMs = 0;
+    uint64_t timestampMus = 0;
     double timeDeltaMs = 0.0;
 
     MoveEvent() = default;
 
-    MoveEvent(double dx, double dy, unsigned long timestampMs, double deltaTime)
-      : timestampMs(timestampMs), timeDeltaMs(deltaTime), dx(dx), dy(dy) {}
+    MoveEvent(double dx, double dy, uint64_t timestampMus, double deltaTime)
+      : dx(dx), dy(dy), timestampMus(timestampMus), timeDeltaMs(deltaTime) {}
   };
 public:
   MouseAcceleration() = default;
@@ -47,17 +50,29 @@ public:
     double rateMultiplier,
     double minMultiplier,
     double maxMultiplier
-  ) : rateMultiplier(rateMultiplier),
-  minMultiplier(minMultiplier),
-  maxMultiplier(maxMultiplier) {}
+  ) : minMultiplier(minMultiplier),
+  maxMultiplier(maxMultiplier),
+  rateMultiplier(rateMultiplier) {}
 
+  // timestamps in us, so motion sampled faster than 1 kHz keeps its
+  // timing. the curve itself still works in ms
   Offsets update(
     double dx,
     double dy,
-    unsigned long timestampMs,
+    uint64_t timestampMus,
     bool clear = false
   );
 
+  // motion measured over sinceMus..timestampMus. its speed comes from that
+  // span instead of the gap to the previous update, which after a pause
+  // says nothing about how fast it moved
+  Offsets update(
+    double dx,
+    double dy,
+    uint64_t sinceMus,
+    uint64_t timestampMus
+  );
+
   void clear() {
     events.clear();
   }
@@ -122,7 +137,7 @@ private:
   double rateMultiplier = 1.0;
   RingBuffer<MoveEvent, max_deltas> events;
 
-  void addEvent(double dx, double dy, unsigned long timestampMs, bool clear = false);
+  void addEvent(double dx, double dy, uint64_t timestampMus, bool clear = false);
   MoveAverage calcAverages() const;
   Offsets calcScroll(const MoveAverage& avg) const;
 };
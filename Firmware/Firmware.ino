@@ -18,6 +18,11 @@
 #include <SPI.h>
 
 #include "Acceleration.h"
+#include "FrameStream.h"
+#include "FrameTimer.h"
+#include "MotionGate.h"
+#include "MotionSampler.h"
+#include "ReportScheduler.h"
 #include "Trackball.h"
 #include "PMW3389.h"
 
@@ -25,21 +30,83 @@
 // config variables
 bool enableMoveAccel = true;
 bool enableScrollAccel = true;
-
-uint16_t throttleMus = 10000;
+bool enableMotionInterrupt = true;
+
+// by default one report per USB poll: reports sent faster are only merged
+uint16_t throttleMus = HID_POLL_INTERVAL_MS * 1000U;
+uint8_t usbPollMs = HID_POLL_INTERVAL_MS;
+
+// frame sync: compose reports frameComposeMus ahead of the load, and load
+// them frameLeadMus before the USB SOF so they leave with the next poll.
+// the sensor is read frameSampleMus ahead of the load, so every report
+// carries a sample of the same age
+bool enableFrameSync = false;
+uint16_t frameLeadMus = 20;
+uint16_t frameComposeMus = 300;
+uint16_t frameSampleMus = 500;
 uint16_t sensorCpi = 800;
+uint16_t sensorCpiY = 0;  // 0: same as sensorCpi
+uint8_t sensorPower = PMW3389_POWER_PERFORMANCE;
+uint8_t sensorLiftConfig = 0x02;
+uint8_t sensorMinSqRun = 0x10;
+uint8_t sensorRawThreshold = 0x0a;
+// read the sensor every sensorSampleMus, e.g. 250 for 4 kHz. 0 reads it
+// as soon as MOT reports motion
+uint16_t sensorSampleMus = 0;
+int8_t sensorAngle = 0;
+bool enableAngleSnap = false;
+
+uint8_t gateMinSqual = 0x08;
+uint8_t gateFullSqual = 0x10;
+uint16_t gateMaxShutter = 0;
+
+// holding precisionButton switches the sensor to precisionCpi
+uint8_t precisionButton = MOUSE_NONE;
+uint16_t precisionCpi = 400;
 
 
 // state variables
 PMW3389 sensor;
-PMW3389_DATA sensorData = {};
-double sensorScale = 0.1;
-double sensorAccumulatedX = 0.0;
-double sensorAccumulatedY = 0.0;
+PMW3389_BURST sensorData = {};
+MotionGate motionGate;
+// counts passed on = sensor counts / sensorScaleDiv. the accumulators keep
+// the remainder in 1/256 counts, the MotionGate gain unit
+uint16_t sensorScaleDiv = 10;
+int32_t sensorAccumulatedX = 0;
+int32_t sensorAccumulatedY = 0;
+
+// bursts read since the last report, dated by when they were started
+MotionSampler motionSampler;
+uint32_t burstMus = 0;
+uint32_t burstSinceMus = 0;
+
+// set from the MOT falling edge, cleared when the burst is read
+volatile bool sensorMotionPending = false;
+volatile uint32_t sensorMotionMus = 0;
+// the last edge taken, i.e. when the motion read next began
+uint32_t lastMotionMus = 0;
+
+// raw frame streaming over Serial1, see FrameStream.h
+bool isCaptureRequested = false;
+uint16_t frameSequence = 0;
+uint16_t frameChecksum = 0;
+
+// one HID report every throttleMus, motion in between is accumulated
+ReportScheduler reportScheduler;
+// the sensor is read on this grid when oversampling or with a locked
+// frame timer, instead of right away. how late each read starts is its
+// phase error
+ReportScheduler sampleScheduler;
+bool isSampleGridOn = false;
+
+// reports the host took per second, measured over one second windows
+uint32_t reportRateStartMs = 0;
+uint32_t reportRateStartCount = 0;
+uint32_t reportRate = 0;
 
 uint64_t nowMus = 0;
-uint64_t lastLoopMus = 0;
-uint64_t lastUpdateMus = 0;
+
+bool isPrecisionMode = false;
 
 uint8_t buttons = 0b00000000;
 uint8_t lastButtons = 0b00000000;
@@ -70,10 +137,257 @@ void printsln(const T& arg, Args... args) {
 }
 
 
-static auto subtractMaxIntegral(double& value, double factor) -> int16_t {
-  double valueF = 0.0;
-  value = modf(value * factor, &valueF) / factor;
-  return static_cast<int16_t>(valueF);
+static auto takeScaledCounts(int32_t& accumulated) -> int32_t {
+  int32_t unit = static_cast<int32_t>(sensorScaleDiv) * 256;
+  int32_t counts = accumulated / unit;  // towards zero, the rest stays
+  accumulated -= counts * unit;
+  return counts;
+}
+
+
+static void onSensorMotion() {
+  // keep the timestamp of the first edge until the loop consumes it
+  if (!sensorMotionPending) {
+    sensorMotionMus = micros();
+    sensorMotionPending = true;
+  }
+}
+
+
+static auto takeSensorMotion() -> bool {
+  if (!enableMotionInterrupt) {
+    return true;
+  }
+
+  noInterrupts();
+  bool isPending = sensorMotionPending;
+  sensorMotionPending = false;
+  if (isPending) {
+    lastMotionMus = sensorMotionMus;
+  }
+  interrupts();
+
+  // MOT stays low while motion data is unread, so a missed edge
+  // (e.g. motion left over from before the ISR was attached) is caught here
+  return isPending || digitalRead(PMW3389_SENSOR_MOT_PIN) == LOW;
+}
+
+
+// waits for the next sample slot when sampling on a grid
+static auto isSampleDue() -> bool {
+  bool wasSampleGridOn = isSampleGridOn;
+  isSampleGridOn = sensorSampleMus != 0 || FrameTimer.isLocked();
+  if (!isSampleGridOn) {
+    return true;
+  }
+
+  // the grid stood still while off, e.g. until the frame timer locked.
+  // start it over instead of counting all that time as skipped samples
+  if (!wasSampleGridOn) {
+    sampleScheduler.start(micros());
+  }
+  return sampleScheduler.isDue(micros());
+}
+
+
+static auto samplePeriodMus() -> uint16_t {
+  return sensorSampleMus != 0 ? sensorSampleMus : throttleMus;
+}
+
+
+// a burst reads the motion built up since the burst before it. after a
+// pause the MOT edge says when it began, if it came after that burst;
+// without one it is taken as one sample period
+static auto motionSinceMus(uint32_t mus) -> uint32_t {
+  uint32_t periodMus = samplePeriodMus();
+  if (mus - burstMus <= 2 * periodMus) {
+    return burstMus;
+  }
+  if (enableMotionInterrupt && mus - lastMotionMus < mus - burstMus) {
+    return lastMotionMus;
+  }
+  return mus - periodMus;
+}
+
+
+// decimation: one move per report with all motion sampled since the last
+static void takeSampledMotion() {
+  MotionWindow window = motionSampler.decimate();
+  if (window.samples == 0) {
+    return;
+  }
+
+  sensorAccumulatedX += window.dx;
+  sensorAccumulatedY += window.dy;
+
+  int32_t dx = takeScaledCounts(sensorAccumulatedX);
+  int32_t dy = takeScaledCounts(sensorAccumulatedY);
+
+  Trackball.move(-dx, dy, window.sinceMus, window.lastMus);
+}
+
+
+static void printBootTiming() {
+  const PMW3389_BOOT_TIMING& boot = sensor.bootTiming();
+  printsln(
+    "Sensor ready (", boot.isWarm ? "warm" : "cold",
+    "): reset ", boot.resetMus,
+    "us, srom ", boot.sromMus,
+    "us, config ", boot.configMus,
+    "us, total ", boot.totalMus, "us"
+  );
+}
+
+
+static void printSensorHealth() {
+  const PMW3389_HEALTH& health = sensor.health();
+  printsln(
+    "Sensor health: frames ", health.frames,
+    ", garbage ", health.garbageFrames,
+    ", srom lost ", health.sromLost,
+    ", resyncs ", health.resyncs,
+    ", missed motion ", health.missedMotion,
+    ", restarts ", health.restarts
+  );
+
+  const MotionGateStats& gate = motionGate.stats();
+  printsln(
+    "Motion gate: passed ", gate.passed,
+    ", attenuated ", gate.attenuated,
+    ", dropped ", gate.dropped,
+    ", lifted ", gate.lifted
+  );
+}
+
+
+static void beginFrameStream() {
+  // read directly: the burst only refreshes diagnostics() on full bursts,
+  // and Shutter_Upper has to be read before Shutter_Lower
+  uint8_t squal = sensor.readReg(REG_SQUAL);
+  uint8_t shutterUpper = sensor.readReg(REG_Shutter_Upper);
+  uint8_t shutterLower = sensor.readReg(REG_Shutter_Lower);
+
+  FrameStreamHeader header = {};
+  memcpy(header.magic, frameStreamMagic, sizeof(header.magic));
+  header.version = frameStreamVersion;
+  header.width = PMW3389_FRAME_SIDE;
+  header.height = PMW3389_FRAME_SIDE;
+  header.squal = squal;
+  header.shutter = static_cast<uint16_t>(shutterUpper << 8 | shutterLower);
+  header.sequence = frameSequence++;
+  header.length = PMW3389_FRAME_PIXELS;
+
+  const auto* bytes = reinterpret_cast<const uint8_t*>(&header);
+  Serial1.write(bytes, sizeof(header));
+  frameChecksum = frameStreamChecksum(0, bytes, sizeof(header));
+
+  sensor.startCapture();
+}
+
+
+static void continueFrameStream() {
+  // only take as many pixels as fit in the UART buffer, so the loop never
+  // blocks on the serial port. the capture, and the stop in navigation,
+  // then lasts as long as the port takes to send the frame: ~1.4 s at
+  // 9600 baud. the 1296 pixels do not fit in RAM to be read faster
+  uint8_t pixels[32];
+  size_t room = min(static_cast<size_t>(Serial1.availableForWrite()), sizeof(pixels));
+  if (room == 0) {
+    return;
+  }
+
+  size_t count = sensor.readCapture(pixels, room);
+  if (count > 0) {
+    Serial1.write(pixels, count);
+    frameChecksum = frameStreamChecksum(frameChecksum, pixels, count);
+  }
+
+  if (!sensor.isCapturing()) {
+    Serial1.write(static_cast<uint8_t>(frameChecksum & 0xff));
+    Serial1.write(static_cast<uint8_t>(frameChecksum >> 8));
+  }
+}
+
+
+static void printReportTiming() {
+  const ReportTimingStats& timing = reportScheduler.stats();
+  uint32_t meanLateMus = timing.reports > 0 ? timing.totalLateMus / timing.reports : 0;
+  printsln(
+    "Reports: ", timing.reports,
+    ", skipped periods ", timing.skipped,
+    ", late mean ", meanLateMus,
+    "us, max ", timing.maxLateMus, "us"
+  );
+}
+
+
+static void updateReportRate() {
+  uint32_t nowMs = millis();
+  uint32_t elapsedMs = nowMs - reportRateStartMs;
+  if (elapsedMs < 1000) {
+    return;
+  }
+
+  uint32_t sent = HID().SentReports();
+  reportRate = (sent - reportRateStartCount) * 1000 / elapsedMs;
+  reportRateStartMs = nowMs;
+  reportRateStartCount = sent;
+}
+
+
+static void printReportRate() {
+  printsln(
+    "USB poll interval: ", HID().PollInterval(),
+    "ms, reports/s: ", reportRate,
+    ", failed sends: ", HID().FailedReports()
+  );
+
+  const MotionSamplerStats& sampler = motionSampler.stats();
+  printsln(
+    "Sensor samples: ", sampler.samples,
+    " in ", sampler.windows,
+    " reports, max per report ", sampler.maxPerWindow,
+    ", merged ", sampler.merged
+  );
+}
+
+
+static void printFrameSync() {
+  if (!FrameTimer.isRunning()) {
+    printsln("Frame sync: off");
+    return;
+  }
+
+  FrameTimerStats frame = FrameTimer.stats();
+  printsln(
+    "Frame sync: ", FrameTimer.isLocked() ? "locked" : "searching",
+    ", ticks ", frame.ticks,
+    ", edges ", frame.edges,
+    ", slips ", frame.slips
+  );
+
+  const ReportTimingStats& sample = sampleScheduler.stats();
+  uint32_t meanLateMus = sample.reports > 0 ? sample.totalLateMus / sample.reports : 0;
+  printsln(
+    "Sample phase error: last ", sample.lastLateMus,
+    "us, mean ", meanLateMus,
+    "us, max ", sample.maxLateMus,
+    "us, skipped slots ", sample.skipped
+  );
+}
+
+
+static void printWakeStats() {
+  for (uint8_t level = 0; level < PMW3389_REST_LEVELS; level++) {
+    const PMW3389_WAKE& wake = sensor.wakeStats(level);
+    uint32_t meanMus = wake.count > 0 ? wake.totalMus / wake.count : 0;
+    if (level == 0) {
+      prints("Wake from run: ");
+    } else {
+      prints("Wake from rest", level, ": ");
+    }
+    printsln(wake.count, " wakes, mean ", meanMus, "us, max ", wake.maxMus, "us");
+  }
 }
 
 
@@ -96,6 +410,63 @@ static void readConfig() {
   EEPROM.get(pos, buttonMap);
   pos += sizeof(buttonMap);
   Trackball.setMappings(buttonMap, sizeof(buttonMap));
+
+  EEPROM.get(pos, enableMotionInterrupt);
+  pos += sizeof(enableMotionInterrupt);
+
+  EEPROM.get(pos, sensorPower);
+  pos += sizeof(sensorPower);
+
+  EEPROM.get(pos, sensorLiftConfig);
+  pos += sizeof(sensorLiftConfig);
+
+  EEPROM.get(pos, sensorMinSqRun);
+  pos += sizeof(sensorMinSqRun);
+
+  EEPROM.get(pos, sensorRawThreshold);
+  pos += sizeof(sensorRawThreshold);
+
+  EEPROM.get(pos, gateMinSqual);
+  pos += sizeof(gateMinSqual);
+
+  EEPROM.get(pos, gateFullSqual);
+  pos += sizeof(gateFullSqual);
+
+  EEPROM.get(pos, gateMaxShutter);
+  pos += sizeof(gateMaxShutter);
+
+  EEPROM.get(pos, sensorCpiY);
+  pos += sizeof(sensorCpiY);
+
+  EEPROM.get(pos, precisionButton);
+  pos += sizeof(precisionButton);
+
+  EEPROM.get(pos, precisionCpi);
+  pos += sizeof(precisionCpi);
+
+  EEPROM.get(pos, sensorAngle);
+  pos += sizeof(sensorAngle);
+
+  EEPROM.get(pos, enableAngleSnap);
+  pos += sizeof(enableAngleSnap);
+
+  EEPROM.get(pos, usbPollMs);
+  pos += sizeof(usbPollMs);
+
+  EEPROM.get(pos, enableFrameSync);
+  pos += sizeof(enableFrameSync);
+
+  EEPROM.get(pos, frameLeadMus);
+  pos += sizeof(frameLeadMus);
+
+  EEPROM.get(pos, frameComposeMus);
+  pos += sizeof(frameComposeMus);
+
+  EEPROM.get(pos, frameSampleMus);
+  pos += sizeof(frameSampleMus);
+
+  EEPROM.get(pos, sensorSampleMus);
+  pos += sizeof(sensorSampleMus);
 }
 
 
@@ -118,15 +489,172 @@ static void writeConfig() {
   Trackball.getMappings(buttonMap, sizeof(buttonMap));
   EEPROM.put(pos, buttonMap);
   pos += sizeof(buttonMap);
+
+  EEPROM.put(pos, enableMotionInterrupt);
+  pos += sizeof(enableMotionInterrupt);
+
+  EEPROM.put(pos, sensorPower);
+  pos += sizeof(sensorPower);
+
+  EEPROM.put(pos, sensorLiftConfig);
+  pos += sizeof(sensorLiftConfig);
+
+  EEPROM.put(pos, sensorMinSqRun);
+  pos += sizeof(sensorMinSqRun);
+
+  EEPROM.put(pos, sensorRawThreshold);
+  pos += sizeof(sensorRawThreshold);
+
+  EEPROM.put(pos, gateMinSqual);
+  pos += sizeof(gateMinSqual);
+
+  EEPROM.put(pos, gateFullSqual);
+  pos += sizeof(gateFullSqual);
+
+  EEPROM.put(pos, gateMaxShutter);
+  pos += sizeof(gateMaxShutter);
+
+  EEPROM.put(pos, sensorCpiY);
+  pos += sizeof(sensorCpiY);
+
+  EEPROM.put(pos, precisionButton);
+  pos += sizeof(precisionButton);
+
+  EEPROM.put(pos, precisionCpi);
+  pos += sizeof(precisionCpi);
+
+  EEPROM.put(pos, sensorAngle);
+  pos += sizeof(sensorAngle);
+
+  EEPROM.put(pos, enableAngleSnap);
+  pos += sizeof(enableAngleSnap);
+
+  EEPROM.put(pos, usbPollMs);
+  pos += sizeof(usbPollMs);
+
+  EEPROM.put(pos, enableFrameSync);
+  pos += sizeof(enableFrameSync);
+
+  EEPROM.put(pos, frameLeadMus);
+  pos += sizeof(frameLeadMus);
+
+  EEPROM.put(pos, frameComposeMus);
+  pos += sizeof(frameComposeMus);
+
+  EEPROM.put(pos, frameSampleMus);
+  pos += sizeof(frameSampleMus);
+
+  EEPROM.put(pos, sensorSampleMus);
+  pos += sizeof(sensorSampleMus);
+}
+
+
+static auto isButtonDown(uint8_t btnId) -> bool {
+  switch (btnId) {
+  case MOUSE_LEFT:
+    return digitalRead(MOUSE_LEFT_BUTTON_PIN) == LOW;
+  case MOUSE_RIGHT:
+    return digitalRead(MOUSE_RIGHT_BUTTON_PIN) == LOW;
+  case MOUSE_BACK:
+    return digitalRead(MOUSE_BACK_BUTTON_PIN) == LOW;
+  case MOUSE_MIDDLE:
+    return digitalRead(MOUSE_MIDDLE_BUTTON_PIN) == LOW;
+  case MOUSE_FORWARD:
+    return digitalRead(MOUSE_FORWARD_BUTTON_PIN) == LOW;
+  case MOUSE_EXTRA1:
+    return digitalRead(MOUSE_EXTRA1_BUTTON_PIN) == LOW;
+  case MOUSE_EXTRA2:
+    return digitalRead(MOUSE_EXTRA2_BUTTON_PIN) == LOW;
+  default:
+    return false;
+  }
+}
+
+
+static void applySensorCpi() {
+  uint16_t baseCpiY = sensorCpiY != 0 ? sensorCpiY : sensorCpi;
+  if (!isPrecisionMode) {
+    sensor.setCPI(sensorCpi, baseCpiY);
+    return;
+  }
+
+  // keep the axis correction while in precision mode
+  uint32_t cpiY = static_cast<uint32_t>(precisionCpi) * baseCpiY / max(sensorCpi, 1);
+  sensor.setCPI(precisionCpi, static_cast<unsigned int>(cpiY));
+}
+
+
+static void updatePrecisionMode() {
+  bool isHeld = precisionCpi != 0 && isButtonDown(precisionButton);
+  if (isHeld == isPrecisionMode) {
+    return;
+  }
+
+  isPrecisionMode = isHeld;
+  applySensorCpi();
+}
+
+
+static void applySensorConfig() {
+  // one SPI transaction for all the register writes
+  sensor.beginBatch();
+  applySensorCpi();
+  sensor.setPowerProfile(static_cast<PMW3389_POWER>(sensorPower));
+  sensor.setLiftConfig(sensorLiftConfig);
+  sensor.setMinSQRun(sensorMinSqRun);
+  sensor.setRawDataThreshold(sensorRawThreshold);
+  sensor.setAngleTune(sensorAngle);
+  sensor.setAngleSnap(enableAngleSnap);
+  sensor.endBatch();
+
+  motionGate.setSqualRange(gateMinSqual, gateFullSqual);
+  motionGate.setMaxShutter(gateMaxShutter);
+}
+
+
+static void onFrame() {
+  Trackball.loadFrame();
+}
+
+
+static void applyFrameSync() {
+  if (enableFrameSync && !FrameTimer.isRunning()) {
+    FrameTimer.start(frameLeadMus, onFrame);
+  } else if (!enableFrameSync && FrameTimer.isRunning()) {
+    FrameTimer.stop();
+  }
+  FrameTimer.setLead(frameLeadMus);
+  Trackball.setFrameSync(enableFrameSync);
 }
 
 
 static void resetConfig() {
   enableMoveAccel = true;
   enableScrollAccel = true;
-
-  throttleMus = 10000;
+  enableMotionInterrupt = true;
+
+  throttleMus = HID_POLL_INTERVAL_MS * 1000U;
+  usbPollMs = HID_POLL_INTERVAL_MS;
+  enableFrameSync = false;
+  frameLeadMus = 20;
+  frameComposeMus = 300;
+  frameSampleMus = 500;
   sensorCpi = 800;
+  sensorCpiY = 0;
+  sensorPower = PMW3389_POWER_PERFORMANCE;
+  sensorLiftConfig = 0x02;
+  sensorMinSqRun = 0x10;
+  sensorRawThreshold = 0x0a;
+  sensorSampleMus = 0;
+  sensorAngle = 0;
+  enableAngleSnap = false;
+
+  gateMinSqual = 0x08;
+  gateFullSqual = 0x10;
+  gateMaxShutter = 0;
+
+  precisionButton = MOUSE_NONE;
+  precisionCpi = 400;
 
   Trackball.setMapping(MOUSE_LEFT, MOUSE_LEFT);
   Trackball.setMapping(MOUSE_RIGHT, MOUSE_RIGHT);
@@ -137,10 +665,7 @@ static void resetConfig() {
   Trackball.setMapping(MOUSE_EXTRA2, MOUSE_EXTRA2);
 
   writeConfig();
-
-  if (sensor.getCPI() != sensorCpi) {
-    sensor.setCPI(sensorCpi);
-  }
+  applySensorConfig();
 }
 
 
@@ -171,50 +696,79 @@ void setup() {
   readConfig();
   printsln("done.");
 
-  prints("Initializing sensor... ");
-  pinMode(PMW3389_SENSOR_NCS_PIN, OUTPUT);
-  digitalWrite(PMW3389_SENSOR_NCS_PIN, HIGH);
-  pinMode(PMW3389_SENSOR_RESET_PIN, OUTPUT);
-  digitalWrite(PMW3389_SENSOR_RESET_PIN, HIGH);
-  // signature check fails, but device works regardless
-  sensor.begin(PMW3389_SENSOR_NCS_PIN, sensorCpi);
-  printsln("done.");
-
   prints("Initializing HID device... ");
+  HID().setPollInterval(usbPollMs);
   Trackball.begin();
   Trackball.setMoveScale(0.50, 0.50);
   Trackball.setScrollScale(0.50, 0.50);
+  applyFrameSync();
+  printsln("done.");
+
+  // bring-up continues in loop() so USB and buttons work in the meantime
+  prints("Starting sensor... ");
+  // high before output: after an MCU reset the port bit is 0, and even a
+  // short low on NRESET resets the sensor and loses a running SROM
+  digitalWrite(PMW3389_SENSOR_NCS_PIN, HIGH);
+  pinMode(PMW3389_SENSOR_NCS_PIN, OUTPUT);
+  digitalWrite(PMW3389_SENSOR_RESET_PIN, HIGH);
+  pinMode(PMW3389_SENSOR_RESET_PIN, OUTPUT);
+  applySensorConfig();
+  sensor.start(PMW3389_SENSOR_NCS_PIN, sensorCpi);
+  printsln("done.");
+
+  prints("Attaching motion interrupt... ");
+  pinMode(PMW3389_SENSOR_MOT_PIN, INPUT_PULLUP);
+  attachInterrupt(
+    digitalPinToInterrupt(PMW3389_SENSOR_MOT_PIN),
+    onSensorMotion,
+    FALLING
+  );
   printsln("done.");
 
   printsln("Initialization done. Entering main loop.");
 
   nowMus = micros();
-  lastLoopMus = nowMus;
-  lastUpdateMus = nowMus;
+  reportScheduler.setPeriod(throttleMus);
+  reportScheduler.start(nowMus);
+  sampleScheduler.setPeriod(samplePeriodMus());
+  sampleScheduler.start(nowMus);
 }
 
 
 void loop() {
   nowMus = micros();
 
-  if (nowMus - lastLoopMus > 0) {
-    sensorData = sensor.readBurst();
-    
-    sensorAccumulatedX += sensorData.dx;
-    sensorAccumulatedY += sensorData.dy;
-
-    int16_t dx = subtractMaxIntegral(sensorAccumulatedX, sensorScale);
-    int16_t dy = subtractMaxIntegral(sensorAccumulatedY, sensorScale);
-
-    Trackball.move(-dx, dy);
+  // the burst is split around the button scan so tSRAD is not spent idle
+  if (sensor.isCapturing()) {
+    continueFrameStream();
+  } else if (!sensor.isReady()) {
+    if (sensor.step()) {
+      printBootTiming();
+    }
+  } else if (isCaptureRequested) {
+    isCaptureRequested = false;
+    beginFrameStream();
+  } else if (!sensor.isBurstPending() && isSampleDue() && takeSensorMotion()) {
+    sensor.startBurst(enableMotionInterrupt);
+    uint32_t mus = micros();
+    burstSinceMus = motionSinceMus(mus);
+    burstMus = mus;
+  }
 
-    Trackball.set(MOUSE_LEFT, (digitalRead(MOUSE_LEFT_BUTTON_PIN) == LOW));
-    Trackball.set(MOUSE_RIGHT, (digitalRead(MOUSE_RIGHT_BUTTON_PIN) == LOW));
-    Trackball.set(MOUSE_BACK, (digitalRead(MOUSE_BACK_BUTTON_PIN) == LOW));
-    Trackball.set(MOUSE_FORWARD, (digitalRead(MOUSE_FORWARD_BUTTON_PIN) == LOW));
-    Trackball.set(MOUSE_MIDDLE, (digitalRead(MOUSE_MIDDLE_BUTTON_PIN) == LOW));
-    Trackball.set(MOUSE_EXTRA1, (digitalRead(MOUSE_EXTRA1_BUTTON_PIN) == LOW));
-    Trackball.set(MOUSE_EXTRA2, (digitalRead(MOUSE_EXTRA2_BUTTON_PIN) == LOW));
+  // the precision button only switches CPI and is never reported
+  for (uint8_t btnId = MOUSE_LEFT; btnId < MOUSE_NONE; btnId++) {
+    Trackball.set(btnId, btnId != precisionButton && isButtonDown(btnId));
+  }
+  updatePrecisionMode();
+
+  if (sensor.pollBurst(sensorData, motionGate.burstLength())) {
+    int32_t gain = motionGate.gain(sensorData);
+    motionSampler.push(
+      burstSinceMus,
+      burstMus,
+      static_cast<int32_t>(sensorData.motion.dx) * gain,
+      static_cast<int32_t>(sensorData.motion.dy) * gain
+    );
   }
 
   KEYHOLE keyhole(Serial1);
@@ -229,6 +783,34 @@ void loop() {
       writeConfig();
     }
 
+    if (keyhole.command("health!")) {
+      printSensorHealth();
+    }
+
+    if (keyhole.command("capture!")) {
+      isCaptureRequested = true;
+    }
+
+    if (keyhole.command("wake!")) {
+      printWakeStats();
+    }
+
+    if (keyhole.command("timing!")) {
+      printReportTiming();
+      reportScheduler.resetStats();
+    }
+
+    if (keyhole.command("rate!")) {
+      printReportRate();
+      motionSampler.resetStats();
+    }
+
+    if (keyhole.command("frame!")) {
+      printFrameSync();
+      FrameTimer.resetStats();
+      sampleScheduler.resetStats();
+    }
+
     uint8_t buttonMap[8];
     Trackball.getMappings(buttonMap, sizeof(buttonMap));
 
@@ -243,16 +825,50 @@ void loop() {
     keyhole.variable("move_accel", enableMoveAccel);
     keyhole.variable("scroll_accel", enableScrollAccel);
     keyhole.variable("throttle_mus", throttleMus);
+    keyhole.variable("usb_poll_ms", usbPollMs);
+    keyhole.variable("frame_sync", enableFrameSync);
+    keyhole.variable("frame_lead_mus", frameLeadMus);
+    keyhole.variable("frame_compose_mus", frameComposeMus);
+    keyhole.variable("frame_sample_mus", frameSampleMus);
+    keyhole.variable("motion_interrupt", enableMotionInterrupt);
 
     keyhole.variable("sensor_cpi", sensorCpi);
+    keyhole.variable("sensor_cpi_y", sensorCpiY);
+    keyhole.variable("sensor_power", sensorPower);
+    keyhole.variable("sensor_lift", sensorLiftConfig);
+    keyhole.variable("sensor_min_sq_run", sensorMinSqRun);
+    keyhole.variable("sensor_raw_threshold", sensorRawThreshold);
+    keyhole.variable("sensor_sample_mus", sensorSampleMus);
+    keyhole.variable("sensor_angle", sensorAngle);
+    keyhole.variable("angle_snap", enableAngleSnap);
+
+    keyhole.variable("gate_min_squal", gateMinSqual);
+    keyhole.variable("gate_full_squal", gateFullSqual);
+    keyhole.variable("gate_max_shutter", gateMaxShutter);
+
+    keyhole.variable("precision_button", precisionButton);
+    keyhole.variable("precision_cpi", precisionCpi);
 
     keyhole.end();
 
-    sensor.setCPI(sensorCpi);
+    applySensorConfig();
+    reportScheduler.setPeriod(throttleMus);
+    sampleScheduler.setPeriod(samplePeriodMus());
+    HID().setPollInterval(usbPollMs);
+    applyFrameSync();
     Trackball.setMappings(buttonMap, sizeof(buttonMap));
   }
 
-  Trackball.send(nowMus);
-  lastUpdateMus = nowMus;
-  lastLoopMus = nowMus;
+  // sample, then compose right before the frame timer loads the report
+  if (FrameTimer.isLocked()) {
+    uint32_t loadMus = FrameTimer.frameMus() - frameLeadMus;
+    sampleScheduler.align(loadMus - frameSampleMus);
+    reportScheduler.align(loadMus - frameComposeMus);
+  }
+
+  if (reportScheduler.isDue(micros())) {
+    takeSampledMotion();
+    Trackball.send(nowMus);
+  }
+  updateReportRate();
 }
@@ -0,0 +1,44 @@
+#ifndef FRAMESTREAM_H55102873
+#define FRAMESTREAM_H55102873
+
+// Wire format of raw sensor frames sent over the config serial port,
+// shared by the firmware and the host decoder.
+//
+// A frame is a FrameStreamHeader, `length` pixel bytes and a Fletcher-16
+// checksum over header and pixels, low byte first. Frames may be
+// interleaved with text output; a reader resyncs on the magic bytes.
+
+#include <stddef.h>
+#include <stdint.h>
+
+constexpr uint8_t frameStreamMagic[4] = {'M', 'B', 'F', 'R'};
+constexpr uint8_t frameStreamVersion = 1;
+
+struct __attribute__((packed)) FrameStreamHeader {
+  uint8_t magic[4];
+  uint8_t version;
+  uint8_t width;
+  uint8_t height;
+  uint8_t squal;      // SQUAL register, read right before the capture
+  uint16_t shutter;   // Shutter_Upper/Lower, read right before the capture
+  uint16_t sequence;  // increments with every frame sent
+  uint16_t length;    // pixel bytes that follow, width * height
+};
+
+static_assert(sizeof(FrameStreamHeader) == 14, "frame stream layout");
+
+
+// running Fletcher-16, start with sum = 0
+inline auto frameStreamChecksum(uint16_t sum, const uint8_t* data, size_t len) -> uint16_t {
+  uint16_t a = sum & 0xff;
+  uint16_t b = sum >> 8;
+
+  for (size_t i = 0; i < len; i++) {
+    a = (a + data[i]) % 255;
+    b = (b + a) % 255;
+  }
+
+  return static_cast<uint16_t>((b << 8) | a);
+}
+
+#endif  // FRAMESTREAM_H55102873
@@ -0,0 +1,148 @@
+#include "Hal.h"
+#include "FrameTimer.h"
+
+#if defined(USBCON)
+
+namespace {
+  // no prescaler: 16 ticks per us, one frame still fits the 16 bit timer
+  constexpr uint16_t ticks_per_mus = F_CPU / 1000000UL;
+  constexpr uint16_t frame_ticks = F_CPU / 1000UL;
+
+  constexpr uint16_t coarse_step = 32 * ticks_per_mus;
+  constexpr uint16_t fine_step = 1 * ticks_per_mus;
+
+  // past this many ticks without landing before a SOF the lock is stale
+  constexpr uint8_t lock_ticks = 4;
+
+  // the lead compare is set from each period, so a period shortened by
+  // up to a coarse step still reaches it. the minimum leaves the tick
+  // interrupt time to return
+  constexpr uint16_t min_lead_mus = 4;
+  constexpr uint16_t max_lead_mus = 900;
+}  // namespace
+
+
+void FrameTimer_t::start(uint16_t leadMus, Callback onFrame) {
+  uint8_t state = Hal::interruptsOff();
+
+  this->onFrame = onFrame;
+  stepTicks = coarse_step;
+  ticksSinceEdge = lock_ticks;
+  lastFrame = UDFNUML;
+  tickMus = Hal::micros();
+
+  // CTC on OCR3A, no prescaler
+  TCCR3A = 0;
+  TCCR3B = (1 << WGM32) | (1 << CS30);
+  TCNT3 = 0;
+  OCR3A = frame_ticks - 1;
+  setLead(leadMus);
+
+  TIFR3 = (1 << OCF3A) | (1 << OCF3B);
+  TIMSK3 = (1 << OCIE3A) | (1 << OCIE3B);
+  isRunning_ = true;
+
+  Hal::interruptsRestore(state);
+}
+
+void FrameTimer_t::stop() {
+  uint8_t state = Hal::interruptsOff();
+  TIMSK3 = 0;
+  TCCR3B = 0;
+  isRunning_ = false;
+  Hal::interruptsRestore(state);
+}
+
+void FrameTimer_t::setLead(uint16_t leadMus) {
+  leadMus = constrain(leadMus, min_lead_mus, max_lead_mus);
+
+  uint8_t state = Hal::interruptsOff();
+  leadTicks = leadMus * ticks_per_mus;
+  OCR3B = OCR3A + 1 - leadTicks;
+  Hal::interruptsRestore(state);
+}
+
+auto FrameTimer_t::isRunning() const -> bool {
+  return isRunning_;
+}
+
+auto FrameTimer_t::isLocked() const -> bool {
+  uint8_t state = Hal::interruptsOff();
+  bool isLocked = isRunning_ && stepTicks == fine_step && ticksSinceEdge < lock_ticks;
+  Hal::interruptsRestore(state);
+  return isLocked;
+}
+
+auto FrameTimer_t::frameMus() const -> uint32_t {
+  uint8_t state = Hal::interruptsOff();
+  uint32_t mus = tickMus;
+  Hal::interruptsRestore(state);
+  return mus;
+}
+
+auto FrameTimer_t::stats() const -> FrameTimerStats {
+  uint8_t state = Hal::interruptsOff();
+  FrameTimerStats stats = stats_;
+  Hal::interruptsRestore(state);
+  return stats;
+}
+
+void FrameTimer_t::resetStats() {
+  uint8_t state = Hal::interruptsOff();
+  stats_ = {};
+  Hal::interruptsRestore(state);
+}
+
+void FrameTimer_t::onTick() {
+  uint8_t frame = UDFNUML;
+  tickMus = Hal::micros();
+  stats_.ticks++;
+
+  // the frame this tick should see if it came after its SOF
+  uint8_t expected = lastFrame + 1;
+  lastFrame = expected;
+
+  // by default drift one step earlier per frame
+  uint16_t period = frame_ticks - stepTicks;
+
+  if (frame == static_cast<uint8_t>(expected - 1)) {
+    // came just before the SOF: halve the step and move behind it again
+    if (stepTicks > fine_step) {
+      stepTicks /= 2;
+    }
+    period = frame_ticks + 2 * stepTicks;
+    ticksSinceEdge = 0;
+    stats_.edges++;
+  } else if (frame != expected) {
+    // suspended, or a tick was delayed past a whole frame. start over
+    lastFrame = frame;
+    stepTicks = coarse_step;
+    ticksSinceEdge = lock_ticks;
+    stats_.slips++;
+  } else if (ticksSinceEdge < lock_ticks) {
+    ticksSinceEdge++;
+  }
+
+  // applies to the period that just started
+  OCR3A = period - 1;
+  OCR3B = period - leadTicks;
+}
+
+void FrameTimer_t::onLead() {
+  if (onFrame != nullptr) {
+    onFrame();
+  }
+}
+
+
+ISR(TIMER3_COMPA_vect) {
+  FrameTimer.onTick();
+}
+
+ISR(TIMER3_COMPB_vect) {
+  FrameTimer.onLead();
+}
+
+FrameTimer_t FrameTimer;
+
+#endif  // USBCON
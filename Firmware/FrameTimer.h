@@ -0,0 +1,62 @@
+#ifndef FRAMETIMER_H28461937
+#define FRAMETIMER_H28461937
+
+#include <stdint.h>
+
+
+struct FrameTimerStats {
+  uint32_t ticks = 0;
+  uint32_t edges = 0;   // ticks that landed just before a SOF
+  uint32_t slips = 0;   // lock lost: no SOF (suspend) or a frame skipped
+};
+
+
+// A 1 ms tick on Timer3 locked to the USB start-of-frame. The core owns
+// the USB interrupts, so the SOF is found by sampling the frame number on
+// each tick: the tick is pulled a step earlier every frame until it lands
+// before a SOF, then pushed back behind it with half the step. Once the
+// step is down to 1 us it keeps dithering within 2 us of the SOF, which
+// also absorbs the difference between our clock and the host's.
+//
+// onFrame runs from the interrupt leadMus before each tick, i.e. just
+// before the host's IN token early in the next frame once locked. It runs
+// every frame while searching too, only not in step with the host. AVR
+// only, and Timer3 must be free (no tone()).
+class FrameTimer_t {
+public:
+  typedef void (*Callback)();
+
+  void start(uint16_t leadMus, Callback onFrame);
+  void stop();
+  void setLead(uint16_t leadMus);
+
+  [[nodiscard]] auto isRunning() const -> bool;
+  [[nodiscard]] auto isLocked() const -> bool;
+
+  // micros() at the last tick, i.e. roughly the last SOF
+  [[nodiscard]] auto frameMus() const -> uint32_t;
+
+  [[nodiscard]] auto stats() const -> FrameTimerStats;
+  void resetStats();
+
+  // called from the Timer3 interrupts
+  void onTick();
+  void onLead();
+
+private:
+  Callback onFrame = nullptr;
+  bool isRunning_ = false;
+
+  uint8_t lastFrame = 0;
+  uint16_t stepTicks = 0;
+  uint8_t ticksSinceEdge = 0;
+  uint16_t leadTicks = 0;
+  uint32_t tickMus = 0;
+
+  FrameTimerStats stats_;
+};
+
+// singleton, the Timer3 interrupts dispatch to it
+extern FrameTimer_t FrameTimer;
+
+#endif  // FRAMETIMER_H28461937
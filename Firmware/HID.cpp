@@ -21,6 +21,9 @@
 
 #if defined(USBCON)
 
+// long enough for the host to notice the disconnect
+#define HID_REENUMERATE_DELAY_MS 100
+
 HID_& HID()
 {
     static HID_ obj;
@@ -29,11 +32,20 @@ HID_& HID()
 
 int HID_::getInterface(uint8_t* interfaceCount)
 {
+    // Runs on every configuration descriptor request, i.e. whenever the host
+    // enumerates. HID 1.11 says the device starts in report protocol, and an
+    // OS enumerating after a BIOS or KVM used boot protocol will not send
+    // SET_PROTOCOL(report) itself. SET_IDLE state starts over as well.
+    protocol = HID_REPORT_PROTOCOL;
+    idle = 0;
+
     *interfaceCount += 1; // uses 1
     HIDDescriptor hidInterface = {
-        D_INTERFACE(pluggedInterface, 2, USB_DEVICE_CLASS_HUMAN_INTERFACE, HID_SUBCLASS_NONE, HID_PROTOCOL_NONE),
+        // boot interface, so a BIOS or KVM that cannot parse the report
+        // descriptor can still switch the mouse to boot protocol
+        D_INTERFACE(pluggedInterface, 2, USB_DEVICE_CLASS_HUMAN_INTERFACE, HID_SUBCLASS_BOOT_INTERFACE, HID_PROTOCOL_MOUSE),
         D_HIDREPORT(descriptorSize),
-        D_ENDPOINT(USB_ENDPOINT_IN(HID_TX), USB_ENDPOINT_TYPE_INTERRUPT, USB_EP_SIZE, 0x14),
+        D_ENDPOINT(USB_ENDPOINT_IN(HID_TX), USB_ENDPOINT_TYPE_INTERRUPT, USB_EP_SIZE, pollInterval),
         D_ENDPOINT(USB_ENDPOINT_OUT(HID_RX), USB_ENDPOINT_TYPE_INTERRUPT, USB_EP_SIZE, 0x0A)
     };
     return USB_SendControl(0, &hidInterface, sizeof(hidInterface));
@@ -168,11 +180,76 @@ bool HID_::LockFeature(uint16_t id, bool lock) {
 
 int HID_::SendReport(uint16_t id, const void* data, int len)
 {
-    auto ret = USB_Send(HID_TX, &id, 1);
-    if (ret < 0) return ret;
-    auto ret2 = USB_Send(HID_TX | TRANSFER_RELEASE, data, len);
-    if (ret2 < 0) return ret2;
-    return ret + ret2;
+    uint8_t packet[USB_EP_SIZE];
+    int head = id != 0 ? 1 : 0;
+    if (!USBDevice.configured() || head + len > (int)sizeof(packet)) {
+        failedReports++;
+        return -1;
+    }
+
+    // USB_Send() would spin until the host polls. Return 0 instead and let
+    // the caller keep the report while the bank is still full.
+    if (USB_SendSpace(HID_TX) < head + len) {
+        return 0;
+    }
+
+    // ID and report in one write, so they always end up in one packet
+    packet[0] = (uint8_t)id;
+    memcpy(packet + head, data, len);
+    int ret = USB_Send(HID_TX | TRANSFER_RELEASE, packet, head + len);
+    if (ret < 0) {
+        failedReports++;
+        return ret;
+    }
+    sentReports++;
+    return ret;
+}
+
+uint32_t HID_::SentReports() const
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t count = sentReports;
+    SREG = sreg;
+    return count;
+}
+
+uint32_t HID_::FailedReports() const
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t count = failedReports;
+    SREG = sreg;
+    return count;
+}
+
+bool HID_::IsEndpointIdle()
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t ep = UENUM;
+    UENUM = HID_TX;
+    bool isIdle = (UESTA0X & ((1 << NBUSYBK1) | (1 << NBUSYBK0))) == 0;
+    UENUM = ep;
+    SREG = sreg;
+    return isIdle;
+}
+
+void HID_::setPollInterval(uint8_t ms)
+{
+    if (ms == 0) {
+        ms = 1;
+    }
+    if (ms == pollInterval) {
+        return;
+    }
+    pollInterval = ms;
+
+    // USBDevice.detach() is empty in the AVR core, so detach by hand.
+    // The host sees a disconnect and requests the descriptors again.
+    UDCON |= (1 << DETACH);
+    delay(HID_REENUMERATE_DELAY_MS);
+    UDCON &= ~(1 << DETACH);
 }
 
 HIDReport* HID_::GetFeature(uint16_t id)
@@ -213,11 +290,10 @@ bool HID_::setup(USBSetup& setup)
             return true;
         }
         if (request == HID_GET_PROTOCOL) {
-            // TODO: Send8(protocol);
-            return true;
+            return USB_SendControl(0, &protocol, 1) > 0;
         }
         if (request == HID_GET_IDLE) {
-            // TODO: Send8(idle);
+            return USB_SendControl(0, &idle, 1) > 0;
         }
     }
 
@@ -230,7 +306,8 @@ bool HID_::setup(USBSetup& setup)
             return true;
         }
         if (request == HID_SET_IDLE) {
-            idle = setup.wValueL;
+            // HID1.11 Page 52 7.2.4: duration in the high byte, report ID in the low
+            idle = setup.wValueH;
             return true;
         }
         if (request == HID_SET_REPORT)
@@ -256,7 +333,9 @@ bool HID_::setup(USBSetup& setup)
 
 HID_::HID_(void) : PluggableUSBModule(2, 1, epType),
                    rootNode(NULL), descriptorSize(0),
-                   protocol(HID_REPORT_PROTOCOL), idle(1)
+                   protocol(HID_REPORT_PROTOCOL), idle(0),
+                   pollInterval(HID_POLL_INTERVAL_MS),
+                   sentReports(0), failedReports(0)
 {
     epType[0] = EP_TYPE_INTERRUPT_IN;
         epType[1] = EP_TYPE_INTERRUPT_OUT;
@@ -21,9 +21,41 @@
 #define HID_h
 
 #include <stdint.h>
+
+#if defined(ARDUINO)
 #include <Arduino.h>
 #include <HardwareSerial.h>
 #include <PluggableUSB.h>
+#else
+#include "Hal.h"
+#endif
+
+class HIDReport {
+public:
+    HIDReport *next = NULL;
+    HIDReport(uint16_t i, const void *d, uint8_t l) : id(i), data(d), length(l) {}
+
+    uint16_t id;
+    const void* data;
+    uint16_t length;
+    bool lock;
+};
+
+class HIDSubDescriptor {
+public:
+  HIDSubDescriptor *next = NULL;
+  HIDSubDescriptor(const void *d, uint16_t l) : data(d), length(l) { }
+
+  const void* data;
+  const uint16_t length;
+};
+
+// Interrupt IN endpoint polling interval (bInterval) in ms on full-speed.
+// The host polls at most this often, so it caps the report rate at
+// 1000 / HID_POLL_INTERVAL_MS. Can be changed at runtime with setPollInterval().
+#ifndef HID_POLL_INTERVAL_MS
+#define HID_POLL_INTERVAL_MS 1
+#endif
 
 #if defined(USBCON)
 
@@ -90,31 +122,15 @@ typedef struct
   EndpointDescriptor  out;                  //added
 } HIDDescriptor;
 
-class HIDReport {
-public:
-    HIDReport *next = NULL;
-    HIDReport(uint16_t i, const void *d, uint8_t l) : id(i), data(d), length(l) {}
-
-    uint16_t id;
-    const void* data;
-    uint16_t length;
-    bool lock;
-};
-
-class HIDSubDescriptor {
-public:
-  HIDSubDescriptor *next = NULL;
-  HIDSubDescriptor(const void *d, uint16_t l) : data(d), length(l) { }
-
-  const void* data;
-  const uint16_t length;
-};
-
 class HID_ : public PluggableUSBModule
 {
 public:
     HID_(void);
     int begin(void);
+    // Never waits for the host: returns 0 without sending if the endpoint
+    // has no room, -1 on error, otherwise the bytes sent. ID 0 is reserved
+    // by the HID spec and sends the report without an ID byte, which is
+    // what boot protocol reports look like.
     int SendReport(uint16_t id, const void* data, int len);
     int SetFeature(uint16_t id, const void* data, int len);
     bool LockFeature(uint16_t id, bool lock);
@@ -129,6 +145,29 @@ public:
         serial = s;
     }
 
+    // The host reads the interval only while enumerating, so a change makes
+    // the device drop off the bus and enumerate again.
+    void setPollInterval(uint8_t ms);
+    uint8_t PollInterval() const { return pollInterval; }
+
+    // Reports accepted by the endpoint. A report is only loaded into a free
+    // bank, so over time this is the rate the host actually polls them at.
+    // Reports may be sent from interrupts, so both read the count atomically.
+    uint32_t SentReports() const;
+    uint32_t FailedReports() const;
+
+    // Idle rate set by the host in 4 ms units. An unchanged report has to
+    // be repeated once this expires; 0 means only send on change.
+    uint8_t IdleRate() const { return idle; }
+
+    // True if the host has taken every report loaded so far, i.e. a report
+    // sent now goes out with the next IN token. Safe in interrupts.
+    bool IsEndpointIdle();
+
+    // Set by the host with SET_PROTOCOL, e.g. a BIOS that does not parse
+    // report descriptors. Reports must then use the fixed boot layout.
+    bool IsBootProtocol() const { return protocol == HID_BOOT_PROTOCOL; }
+
     HIDReport* GetFeature(uint16_t id);
 
 protected:
@@ -146,6 +185,10 @@ private:
 
     uint8_t protocol;
     uint8_t idle;
+    uint8_t pollInterval;
+
+    volatile uint32_t sentReports;
+    volatile uint32_t failedReports;
 
     // Buffer pointer to hold the feature data
     HIDReport* rootReport;
@@ -164,6 +207,67 @@ HID_& HID();
 
 #define D_HIDREPORT(length) { 9, 0x21, 0x01, 0x01, 0x21, 1, 0x22, lowByte(length), highByte(length) }
 
+#elif !defined(ARDUINO)
+
+// Host build (see HalPosix.h): same interface, but instead of going to an
+// endpoint every report is handed to a sink set with setReportSink().
+class HID_
+{
+public:
+    typedef void (*ReportSink)(uint16_t id, const void* data, int len, void* context);
+
+    HID_(void);
+    int begin(void);
+    int SendReport(uint16_t id, const void* data, int len);
+    int SetFeature(uint16_t id, const void* data, int len);
+    bool LockFeature(uint16_t id, bool lock);
+
+    void AppendDescriptor(HIDSubDescriptor* node);
+
+    void setReportSink(ReportSink sink, void* context);
+
+    void setPollInterval(uint8_t ms);
+    uint8_t PollInterval() const { return pollInterval; }
+
+    uint32_t SentReports() const { return sentReports; }
+    uint32_t FailedReports() const { return failedReports; }
+
+    // stands in for a host that does not poll: SendReport() returns 0
+    void setBusy(bool isBusy) { busy = isBusy; }
+    bool IsEndpointIdle() { return !busy; }
+
+    // stands in for the host's SET_PROTOCOL request
+    void setBootProtocol(bool isBoot) { bootProtocol = isBoot; }
+    bool IsBootProtocol() const { return bootProtocol; }
+
+    // stands in for the host's SET_IDLE request
+    void setIdleRate(uint8_t rate) { idle = rate; }
+    uint8_t IdleRate() const { return idle; }
+
+    HIDReport* GetFeature(uint16_t id);
+    uint16_t DescriptorSize() const;
+
+private:
+    HIDSubDescriptor* rootNode;
+    uint16_t descriptorSize;
+
+    HIDReport* rootReport;
+    uint16_t reportCount;
+
+    uint8_t pollInterval;
+    uint8_t idle;
+    bool busy;
+    bool bootProtocol;
+
+    uint32_t sentReports;
+    uint32_t failedReports;
+
+    ReportSink sink;
+    void* sinkContext;
+};
+
+HID_& HID();
+
 #endif // USBCON
 
 #endif // HID_h
@@ -0,0 +1,101 @@
+#ifndef HAL_H51220873
+#define HAL_H51220873
+
+// Compile-time hardware abstraction for the sensor driver and the
+// trackball pipeline. Each backend provides a `Hal` struct of static
+// functions; callers use `Hal::` directly, so on AVR every call inlines to
+// the Arduino core function it wraps and costs nothing extra.
+//
+//   clock   micros(), millis(), delayMicros(), delayMillis()
+//   pins    pinOutput(), pinInputPullup(), pinWrite(), pinRead()
+//   bus     spiBegin(), spiBeginTransaction(), spiEndTransaction(),
+//           spiTransfer()
+//   flash   flashByte()
+//   irq     interruptsOff(), interruptsRestore()
+//
+// The USB endpoint is abstracted one level up, by HID_ in HID.h.
+
+#if defined(ARDUINO)
+
+#include <Arduino.h>
+#include <SPI.h>
+
+struct Hal {
+  static inline auto micros() -> uint32_t {
+    return ::micros();
+  }
+
+  static inline auto millis() -> uint32_t {
+    return ::millis();
+  }
+
+  // at most 16383 us on a 16 MHz AVR
+  static inline void delayMicros(unsigned int us) {
+    ::delayMicroseconds(us);
+  }
+
+  static inline void delayMillis(uint32_t ms) {
+    ::delay(ms);
+  }
+
+  static inline void pinOutput(uint8_t pin) {
+    ::pinMode(pin, OUTPUT);
+  }
+
+  static inline void pinInputPullup(uint8_t pin) {
+    ::pinMode(pin, INPUT_PULLUP);
+  }
+
+  static inline void pinWrite(uint8_t pin, uint8_t level) {
+    ::digitalWrite(pin, level);
+  }
+
+  static inline auto pinRead(uint8_t pin) -> uint8_t {
+    return ::digitalRead(pin);
+  }
+
+  static inline void spiBegin() {
+    SPI.begin();
+  }
+
+  // mode 3, MSB first; the only kind of device on this bus
+  static inline void spiBeginTransaction(uint32_t clockHz) {
+    SPI.beginTransaction(SPISettings(clockHz, MSBFIRST, SPI_MODE3));
+  }
+
+  static inline void spiEndTransaction() {
+    SPI.endTransaction();
+  }
+
+  static inline auto spiTransfer(uint8_t data) -> uint8_t {
+    return SPI.transfer(data);
+  }
+
+  static inline void spiTransfer(void* buf, size_t len) {
+    SPI.transfer(buf, len);
+  }
+
+  static inline auto flashByte(const uint8_t* addr) -> uint8_t {
+    return pgm_read_byte(addr);
+  }
+
+  // guards state shared with an interrupt handler. returns the previous
+  // state for interruptsRestore(), so it nests
+  static inline auto interruptsOff() -> uint8_t {
+    uint8_t state = SREG;
+    cli();
+    return state;
+  }
+
+  static inline void interruptsRestore(uint8_t state) {
+    SREG = state;
+  }
+};
+
+#else
+
+#include "HalPosix.h"
+
+#endif
+
+#endif  // HAL_H51220873
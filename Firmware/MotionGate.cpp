@@ -0,0 +1,65 @@
+#include "MotionGate.h"
+
+namespace {
+  constexpr uint8_t motion_lift_stat = 0x08;
+  constexpr uint16_t full_gain = 256;
+
+  // offsets into the burst, see PMW3389_BURST
+  constexpr uint8_t burst_squal_end = 7;
+}  // namespace
+
+
+void MotionGate::setSqualRange(uint8_t minSqual, uint8_t fullSqual) {
+  this->minSqual = minSqual;
+  this->fullSqual = fullSqual;
+}
+
+void MotionGate::setMaxShutter(uint16_t maxShutter) {
+  this->maxShutter = maxShutter;
+}
+
+auto MotionGate::burstLength() const -> uint8_t {
+  if (maxShutter != 0) {
+    return PMW3389_BURST_FULL;
+  }
+  if (minSqual != 0 || fullSqual != 0) {
+    return burst_squal_end;
+  }
+  return PMW3389_BURST_FAST;
+}
+
+auto MotionGate::gain(const PMW3389_BURST& burst) -> uint16_t {
+  if (burst.motion.motion & motion_lift_stat) {
+    stats_.lifted++;
+    return 0;
+  }
+
+  if (maxShutter != 0) {
+    uint16_t shutter = static_cast<uint16_t>(burst.shutterUpper << 8 | burst.shutterLower);
+    if (shutter > maxShutter) {
+      stats_.dropped++;
+      return 0;
+    }
+  }
+
+  if (burst.SQUAL < minSqual) {
+    stats_.dropped++;
+    return 0;
+  }
+
+  if (burst.SQUAL < fullSqual) {
+    stats_.attenuated++;
+    return static_cast<uint16_t>((burst.SQUAL - minSqual) * full_gain / (fullSqual - minSqual));
+  }
+
+  stats_.passed++;
+  return full_gain;
+}
+
+auto MotionGate::stats() const -> const MotionGateStats& {
+  return stats_;
+}
+
+void MotionGate::resetStats() {
+  stats_ = {};
+}
@@ -0,0 +1,43 @@
+#ifndef MOTIONGATE_H61530284
+#define MOTIONGATE_H61530284
+
+#include "PMW3389.h"
+
+
+struct MotionGateStats {
+  uint32_t passed = 0;
+  uint32_t attenuated = 0;
+  uint32_t dropped = 0;    // bad image: SQUAL too low or shutter too long
+  uint32_t lifted = 0;     // Lift_Stat set
+};
+
+
+// Scales down or drops motion from frames the sensor could not image
+// properly, e.g. with the ball removed, dirty or covered in debris. Each
+// check is a few integer comparisons, so it runs on every burst.
+class MotionGate {
+public:
+  // below minSqual motion is dropped, from there up to fullSqual it is
+  // scaled linearly. fullSqual <= minSqual makes it a hard cutoff. 0, 0 disables
+  void setSqualRange(uint8_t minSqual, uint8_t fullSqual);
+  // drop frames whose shutter exceeds maxShutter (too dark). 0 disables
+  void setMaxShutter(uint16_t maxShutter);
+
+  // burst bytes the enabled checks need, for PMW3389::pollBurst()
+  [[nodiscard]] auto burstLength() const -> uint8_t;
+
+  // gain for this frame's motion, out of 256. 0 drops it
+  auto gain(const PMW3389_BURST& burst) -> uint16_t;
+
+  [[nodiscard]] auto stats() const -> const MotionGateStats&;
+  void resetStats();
+
+private:
+  uint8_t minSqual = 0;
+  uint8_t fullSqual = 0;
+  uint16_t maxShutter = 0;
+
+  MotionGateStats stats_;
+};
+
+#endif  // MOTIONGATE_H61530284
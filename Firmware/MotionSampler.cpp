@@ -0,0 +1,52 @@
+#include "MotionSampler.h"
+
+
+void MotionSampler::push(uint32_t sinceMus, uint32_t mus, int32_t dx, int32_t dy) {
+  if (samples.size() == samples.max_size()) {
+    MotionSample oldest = samples.front();
+    samples.pop_front();
+    samples.front().sinceMus = oldest.sinceMus;
+    samples.front().dx += oldest.dx;
+    samples.front().dy += oldest.dy;
+    stats_.merged++;
+  }
+
+  samples.emplace_back(sinceMus, mus, dx, dy);
+  stats_.samples++;
+}
+
+auto MotionSampler::decimate() -> MotionWindow {
+  MotionWindow window;
+  if (samples.empty()) {
+    return window;
+  }
+
+  window.sinceMus = samples.front().sinceMus;
+  window.lastMus = samples.back().mus;
+  window.samples = static_cast<uint8_t>(samples.size());
+
+  for (size_t i = 0; i < samples.size(); i++) {
+    window.dx += samples[i].dx;
+    window.dy += samples[i].dy;
+  }
+  samples.clear();
+
+  stats_.windows++;
+  if (window.samples > stats_.maxPerWindow) {
+    stats_.maxPerWindow = window.samples;
+  }
+
+  return window;
+}
+
+auto MotionSampler::isEmpty() const -> bool {
+  return samples.empty();
+}
+
+auto MotionSampler::stats() const -> const MotionSamplerStats& {
+  return stats_;
+}
+
+void MotionSampler::resetStats() {
+  stats_ = {};
+}
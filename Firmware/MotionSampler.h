@@ -0,0 +1,67 @@
+#ifndef MOTIONSAMPLER_H95027341
+#define MOTIONSAMPLER_H95027341
+
+#include <stdint.h>
+#include <string.h>
+
+#include "RingBuffer.h"
+
+
+struct MotionSample {
+  uint32_t sinceMus = 0;  // when the motion began building up
+  uint32_t mus = 0;       // when the burst was started
+  int32_t dx = 0;
+  int32_t dy = 0;
+
+  MotionSample() = default;
+
+  MotionSample(uint32_t sinceMus, uint32_t mus, int32_t dx, int32_t dy)
+    : sinceMus(sinceMus), mus(mus), dx(dx), dy(dy) {}
+};
+
+
+// all motion sampled since the last report
+struct MotionWindow {
+  int32_t dx = 0;
+  int32_t dy = 0;
+  uint32_t sinceMus = 0;  // span the motion was measured over
+  uint32_t lastMus = 0;
+  uint8_t samples = 0;
+};
+
+
+struct MotionSamplerStats {
+  uint32_t samples = 0;
+  uint32_t windows = 0;
+  uint8_t maxPerWindow = 0;
+  uint32_t merged = 0;   // samples folded into a neighbour on overflow
+};
+
+
+// Collects sensor samples taken faster than reports are sent and reduces
+// them to one window per report. Sample times are kept, so the report's
+// motion can be dated, and its speed measured, by when it was sampled
+// rather than when it is sent.
+class MotionSampler {
+public:
+  // when full, the two oldest samples merge, so no motion is lost
+  void push(uint32_t sinceMus, uint32_t mus, int32_t dx, int32_t dy);
+
+  // sums and empties everything pushed since the last call
+  auto decimate() -> MotionWindow;
+
+  [[nodiscard]] auto isEmpty() const -> bool;
+
+  [[nodiscard]] auto stats() const -> const MotionSamplerStats&;
+  void resetStats();
+
+private:
+  // 8 kHz sampling with 2 ms reports
+  constexpr static int max_samples = 16;
+
+  RingBuffer<MotionSample, max_samples> samples;
+
+  MotionSamplerStats stats_;
+};
+
+#endif  // MOTIONSAMPLER_H95027341
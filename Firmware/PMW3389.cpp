@@ -528,10 +528,94 @@
 
 #include "PMW3389.h"
 
-#define BEGIN_COM digitalWrite(_ss, LOW); delayMicroseconds(1)
-#define END_COM   delayMicroseconds(1); digitalWrite(_ss, HIGH)
-#define SPI_BEGIN SPI.beginTransaction(SPISettings(8000000, MSBFIRST, SPI_MODE3))
-#define SPI_END   SPI.endTransaction()
+// tNCS-SCLK and tSCLK-NCS (read) are 120ns, shorter than a pin write itself
+#define BEGIN_COM Hal::pinWrite(_ss, LOW)
+#define END_COM   Hal::pinWrite(_ss, HIGH)
+#define SPI_BEGIN beginTransaction()
+#define SPI_END   endTransaction()
+
+// datasheet minimums, in us
+#define T_SWW         180 // end of write to next write
+#define T_SWR         180 // end of write to next read
+#define T_SRW         20  // end of read to next write
+#define T_SRR         20  // end of read to next read
+#define T_SRAD        160 // read address to data
+#define T_SRAD_MOTBR  35  // motion burst address to first data byte
+#define T_SCLK_NCS_WR 35  // last write clock to NCS release
+#define T_LOAD        15  // between SROM_Load_Burst bytes
+#define T_SROM_EXIT   200 // end of SROM download to SROM_ID read
+#define T_SROM_INIT   10000 // SROM_Enable 0x1d to 0x18
+#define T_SROM_CRC    10000 // SROM_Enable 0x15 to Data_Out read
+#define T_POWER_UP    50000 // Power_Up_Reset to first register access
+#define T_FRAME_CAPTURE 20000 // Frame_Capture 0xc5 to Raw_Data_Burst read
+
+#define MICROS_STEP   4   // micros() only advances in 4 us steps on a 16 MHz AVR
+#define SROM_CHUNK    64  // SROM bytes per step(), about 1 ms of upload
+
+#define BURST_LAPSE      500000UL // burst mode is re-entered after this long without a burst, in us
+#define MOTION_MOT       0x80     // motion since the last read
+#define MOTION_RESERVED  0x71     // reserved bits and Frame_Pix_First
+#define MOTION_OP_MODE   0x06     // nonzero in rest modes
+#define OBSERVATION_SROM 0x40     // SROM_RUN
+#define GARBAGE_LIMIT    8        // consecutive discarded bursts before a restart
+
+#define WAKE_IDLE_MS     50       // gap without motion that counts as idle for wake stats
+#define WAKE_BURSTS      4        // bursts after the wake burst used to estimate speed
+#define WAKE_WINDOW      50000UL  // us the follow-up bursts must arrive in
+#define CONFIG2_REST_EN  0x20
+#define CONFIG2_RPT_MOD  0x04     // Config5 sets the Y resolution
+#define ANGLE_TUNE_MAX   30       // degrees either way
+#define ANGLE_SNAP_EN    0x80
+
+/*
+Rest mode schedule for one power profile. The sensor drops from run to
+rest1 after Run_Downshift * 10 ms, to rest2 after Rest1_Downshift * 320
+rest1 frames and to rest3 after Rest2_Downshift * 32 rest2 frames. A rest
+frame lasts (Rest_Rate + 1) ms.
+*/
+struct POWER_PROFILE
+{
+  byte config2;
+  byte runDownshift;
+  uint16_t rest1Rate;
+  byte rest1Downshift;
+  uint16_t rest2Rate;
+  byte rest2Downshift;
+  uint16_t rest3Rate;
+};
+
+static const POWER_PROFILE power_profiles[PMW3389_POWER_COUNT] = {
+  // performance: rest disabled, schedule at power up values
+  {0x00,            0x32, 0x0000, 0x1f, 0x0063, 0xbc, 0x01f3},
+  // balanced: rest1 at 1 kHz after 500 ms, rest2 at 50 Hz after 10 s, rest3 at 10 Hz after 1 min
+  {CONFIG2_REST_EN, 0x32, 0x0000, 0x1f, 0x0013, 0x5e, 0x0063},
+  // battery: rest1 at 500 Hz after 100 ms, rest2 at 10 Hz after 6 s, rest3 at 2 Hz after 1 min
+  {CONFIG2_REST_EN, 0x0a, 0x0001, 0x09, 0x0063, 0x13, 0x01f3},
+};
+
+/*
+Registers that only change when written, so the driver keeps a copy:
+reads are served from RAM and writes of the current value are skipped.
+*/
+static const byte shadow_regs[PMW3389_SHADOW_REGS] = {
+  REG_Config1,
+  REG_Config2,
+  REG_Angle_Tune,
+  REG_Run_Downshift,
+  REG_Rest1_Rate_Lower,
+  REG_Rest1_Rate_Upper,
+  REG_Rest1_Downshift,
+  REG_Rest2_Rate_Lower,
+  REG_Rest2_Rate_Upper,
+  REG_Rest2_Downshift,
+  REG_Rest3_Rate_Lower,
+  REG_Rest3_Rate_Upper,
+  REG_Min_SQ_Run,
+  REG_Raw_Data_Threshold,
+  REG_Config5,
+  REG_Angle_Snap,
+  REG_Lift_Config,
+};
 
 const unsigned short firmware_length = 4094;
 const unsigned char firmware_data[] PROGMEM = {
@@ -820,86 +904,294 @@ PMW3389::PMW3389()
 // public
 /*
 begin: initalize variables, prepare the sensor to be init.
+  Blocks until the sensor is ready; see start()/step() for the
+  non-blocking equivalent.
 
 # parameter
 ss_pin: The arduino pin that is connected to slave select on the module.
 CPI: initial CPI. optional.
+allowWarmStart: skip the power cycle and SROM upload if a valid SROM is
+  already running, e.g. after a watchdog reset of the MCU. optional.
+# retrun
+true if the signature check passed.
+*/
+bool PMW3389::begin(unsigned int ss_pin, unsigned int CPI, bool allowWarmStart)
+{
+  start(ss_pin, CPI, allowWarmStart);
+  while(!step())
+  {
+  }
+
+  return _signatureOk;
+}
+
+// public
+/*
+start: begin bringing the sensor up without blocking. Call step() until
+  it returns true; until then the sensor must not be read.
+
+# parameter
+see begin()
 */
-bool PMW3389::begin(unsigned int ss_pin, unsigned int CPI)
+void PMW3389::start(unsigned int ss_pin, unsigned int CPI, bool allowWarmStart)
 {
   _ss = ss_pin;
+  _cpi = CPI;
   _inBurst = false;
-  pinMode(_ss, OUTPUT);
-  digitalWrite(_ss, HIGH);
-
-  SPI.begin();
+  _burstPending = false;
+  _signatureOk = false;
+  _burstLost = false;
+  _garbageRun = 0;
+  _bootTiming = {};
+  _bootStart = Hal::micros();
+  _lastMotionAt = _bootStart;
+  _wakeBursts = 0;
+  _shadowValid = 0;
+  Hal::pinWrite(_ss, HIGH); // high first, so NCS never glitches low
+  Hal::pinOutput(_ss);
+
+  Hal::spiBegin();
   // SPI.setDataMode(SPI_MODE3);
   // SPI.setBitOrder(MSBFIRST);
 
-  // hard reset
   SPI_BEGIN;
   END_COM; BEGIN_COM; END_COM; // ensure that the serial port is reset
-
-  adns_write_reg(REG_Shutdown, 0xb6); // Shutdown first
   SPI_END;
-  delay(300);
 
-  SPI_BEGIN;
-  BEGIN_COM;
-  delayMicroseconds(40);
-  END_COM;
-  delayMicroseconds(40);
+  _state = allowWarmStart ? PMW3389_WARM_CHECK : PMW3389_RESET;
+}
 
-  adns_write_reg(REG_Power_Up_Reset, 0x5a); // force reset
-  SPI_END;
-  delay(50); // wait for it to reboot
+// public
+/*
+step: advance sensor bring-up by one state. Each call does at most a few
+  register accesses or one chunk of the SROM upload; the datasheet waits
+  in between are measured from timestamps and never spent blocking.
 
+# retrun
+true once the sensor is ready for use.
+*/
+bool PMW3389::step()
+{
   SPI_BEGIN;
-  // read registers 0x02 to 0x06 (and discard the data)
-  adns_read_reg(REG_Motion);
-  adns_read_reg(REG_Delta_X_L);
-  adns_read_reg(REG_Delta_X_H);
-  adns_read_reg(REG_Delta_Y_L);
-  adns_read_reg(REG_Delta_Y_H);
-  // upload the firmware
-  adns_upload_firmware();
-  //SPI.endTransaction();
+
+  switch(_state)
+  {
+  case PMW3389_OFF:
+  case PMW3389_READY:
+  case PMW3389_CAPTURE_WAIT:
+  case PMW3389_CAPTURE:
+    break;
+
+  case PMW3389_WARM_CHECK:
+  {
+    // warm start: the sensor kept power across an MCU reset and may still
+    // run a valid SROM. a freshly powered chip reports SROM_ID 0x00.
+    byte pid = adns_read_reg(REG_Product_ID);
+    byte iv_pid = adns_read_reg(REG_Inverse_Product_ID);
+    byte SROM_ver = adns_read_reg(REG_SROM_ID);
+
+    if(pid == 0x42 && iv_pid == 0xBD && SROM_ver == 0x04)
+    {
+      adns_write_reg(REG_SROM_Enable, 0x15); // start SROM CRC test
+      _phaseAt = Hal::micros();
+      _state = PMW3389_WARM_CRC;
+    }
+    else
+    {
+      _state = PMW3389_RESET;
+    }
+    break;
+  }
+
+  case PMW3389_WARM_CRC:
+    if(hasElapsed(_phaseAt, T_SROM_CRC))
+    {
+      byte crcLower = adns_read_reg(REG_Data_Out_Lower);
+      byte crcUpper = adns_read_reg(REG_Data_Out_Upper);
+
+      if(crcUpper == 0xBE && crcLower == 0xEF)
+      {
+        clear_motion();
+        _bootTiming.isWarm = true;
+        _sromStart = Hal::micros();
+        _configStart = _sromStart;
+        _state = PMW3389_CONFIG;
+      }
+      else
+      {
+        _state = PMW3389_RESET;
+      }
+    }
+    break;
+
+  case PMW3389_RESET:
+    // hard reset. Power_Up_Reset also brings the chip out of shutdown, so
+    // only the register timing guard is needed between the two writes.
+    adns_write_reg(REG_Shutdown, 0xb6); // Shutdown first
+    adns_write_reg(REG_Power_Up_Reset, 0x5a); // force reset
+    _phaseAt = Hal::micros();
+    _state = PMW3389_RESET_WAIT;
+    break;
+
+  case PMW3389_RESET_WAIT:
+    if(hasElapsed(_phaseAt, T_POWER_UP))
+    {
+      clear_motion();
+      _sromStart = Hal::micros();
+
+      //Write 0 to Rest_En bit of Config2 register to disable Rest mode.
+      adns_write_reg(REG_Config2, 0x00);
+
+      // write 0x1d in SROM_enable reg for initializing
+      adns_write_reg(REG_SROM_Enable, 0x1d);
+      _phaseAt = Hal::micros();
+      _state = PMW3389_SROM_INIT;
+    }
+    break;
+
+  case PMW3389_SROM_INIT:
+    // wait for more than one frame period
+    if(hasElapsed(_phaseAt, T_SROM_INIT))
+    {
+      // write 0x18 to SROM_enable to start SROM download
+      adns_write_reg(REG_SROM_Enable, 0x18);
+
+      // write the SROM file (=firmware data). NCS stays low until the
+      // last byte, across as many step() calls as the upload takes.
+      waitGuard(true);
+      BEGIN_COM;
+      Hal::spiTransfer(REG_SROM_Load_Burst | 0x80); // write burst destination adress
+      _sromPos = 0;
+      _state = PMW3389_SROM_LOAD;
+    }
+    break;
+
+  case PMW3389_SROM_LOAD:
+    upload_firmware_chunk();
+    if(_sromPos >= firmware_length)
+    {
+      END_COM;
+      markCom(COM_WRITE);
+      _phaseAt = Hal::micros();
+      _state = PMW3389_SROM_EXIT;
+    }
+    break;
+
+  case PMW3389_SROM_EXIT:
+    if(hasElapsed(_phaseAt, T_SROM_EXIT))
+    {
+      //Read the SROM_ID register to verify the ID before any other register reads or writes.
+      adns_read_reg(REG_SROM_ID);
+
+      // the SROM starts from its own defaults, and Config2 was cleared
+      // for the download, so nothing shadowed before holds any more
+      _shadowValid = 0;
+
+      _configStart = Hal::micros();
+      _state = PMW3389_CONFIG;
+    }
+    break;
+
+  case PMW3389_CONFIG:
+  {
+    // the rest schedule before anything writes Config2 with Rest_En;
+    // write_cpi() then finds Config2 already up to date
+    write_power();
+    write_cpi();
+    write_surface();
+    write_angle();
+    _signatureOk = check_signature();
+
+    uint32_t bootEnd = Hal::micros();
+    _bootTiming.resetMus = _sromStart - _bootStart;
+    _bootTiming.sromMus = _configStart - _sromStart;
+    _bootTiming.configMus = bootEnd - _configStart;
+    _bootTiming.totalMus = bootEnd - _bootStart;
+
+    _state = PMW3389_READY;
+    break;
+  }
+  }
+
   SPI_END;
 
-  delay(10);
-  setCPI(CPI);
+  return _state == PMW3389_READY;
+}
+
+// public
+bool PMW3389::isReady() const
+{
+  return _state == PMW3389_READY;
+}
+
+// public
+PMW3389_STATE PMW3389::state() const
+{
+  return _state;
+}
 
-  return check_signature();
+// public
+/*
+bootTiming: how long each phase of the last bring-up took.
+*/
+const PMW3389_BOOT_TIMING& PMW3389::bootTiming() const
+{
+  return _bootTiming;
 }
 
 // public
 /*
-setCPI: set CPI level of the motion sensor.
+setCPI: set CPI level of the motion sensor, the same on both axes. Before
+  the sensor is ready the value is kept and applied at the end of
+  bring-up.
 
 # parameter
 cpi: Count per Inch value
 */
 void PMW3389::setCPI(unsigned int cpi)
 {
-  int cpival = constrain((cpi/100)-1, 0, 0x77); // limits to 0--119
-  //_CPI = (cpival + 1)*100;
+  setCPI(cpi, cpi);
+}
 
-  SPI_BEGIN;
-  adns_write_reg(REG_Config1, cpival);
-  SPI_END;
+// public
+/*
+setCPI: set the X and Y CPI separately. Unequal values switch the sensor
+  to Config5 for Y; only registers that change are written.
+
+# parameter
+cpiX: Count per Inch value for X
+cpiY: Count per Inch value for Y
+*/
+void PMW3389::setCPI(unsigned int cpiX, unsigned int cpiY)
+{
+  _cpi = cpiX;
+  _cpiY = cpiY;
+
+  if(isReady())
+  {
+    SPI_BEGIN;
+    write_cpi();
+    SPI_END;
+  }
 }
 
 // public
 /*
 getCPI: get CPI level of the motion sensor.
+  (from the register shadow once the sensor is ready, see refresh())
 
 # retrun
 cpi: Count per Inch value
 */
 unsigned int PMW3389::getCPI()
 {
+  if(!isReady())
+  {
+    return _cpi;
+  }
+
   SPI_BEGIN;
-  int cpival = adns_read_reg(REG_Config1);
+  int cpival = read_config_reg(REG_Config1);
   SPI_END;
 
   return (cpival + 1)*100;
@@ -907,231 +1199,1038 @@ unsigned int PMW3389::getCPI()
 
 // public
 /*
-readBurst: get one frame of motion data.
+getCPIY: get the Y CPI level, which is the X level unless Config5 is in use.
 
 # retrun
-type: PMW3389_DATA
+cpi: Count per Inch value
 */
-PMW3389_DATA PMW3389::readBurst()
+unsigned int PMW3389::getCPIY()
 {
-  unsigned long fromLast = micros() - _lastBurst;
-  byte burstBuffer[12];
-
-  SPI_BEGIN;
-
-  if(!_inBurst || fromLast > 500*1000)
+  if(!isReady())
   {
-    adns_write_reg(REG_Motion_Burst, 0x00);
-    _inBurst = true;
+    return _cpiY;
   }
 
-  BEGIN_COM;
-  SPI.transfer(REG_Motion_Burst);
-  delayMicroseconds(35); // waits for tSRAD
+  SPI_BEGIN;
+  byte reg = (read_config_reg(REG_Config2) & CONFIG2_RPT_MOD) ? REG_Config5 : REG_Config1;
+  int cpival = read_config_reg(reg);
+  SPI_END;
 
-  SPI.transfer(burstBuffer, 12); // read burst buffer
-  delayMicroseconds(1); // tSCLK-NCS for read operation is 120ns
+  return (cpival + 1)*100;
+}
 
-  END_COM;
-  SPI_END;
+/*
+write_cpi: write the stored CPI to Config1, and to Config5 for a
+  separate Y resolution.
+*/
+void PMW3389::write_cpi()
+{
+  int cpival = constrain((_cpi/100)-1, 0, 0x77); // limits to 0--119
+  write_config_reg(REG_Config1, cpival);
 
-  if(burstBuffer[0] & 0b111) // panic recovery, sometimes burst mode works weird.
+  if(_cpiY != _cpi)
   {
-    _inBurst = false;
+    int cpivalY = constrain((_cpiY/100)-1, 0, 0x77);
+    write_config_reg(REG_Config5, cpivalY);
   }
 
-  _lastBurst = micros();
+  write_config_reg(REG_Config2, config2());
+}
+
+/*
+config2: Config2 for the current power profile and CPI mode.
+*/
+byte PMW3389::config2() const
+{
+  byte value = power_profiles[_power].config2;
+  if(_cpiY != _cpi)
+  {
+    value |= CONFIG2_RPT_MOD;
+  }
+  return value;
+}
 
-  PMW3389_DATA data;
+/*
+write_surface: write the lift and surface quality tuning.
+*/
+void PMW3389::write_surface()
+{
+  write_config_reg(REG_Lift_Config, _liftConfig);
+  write_config_reg(REG_Min_SQ_Run, _minSQRun);
+  write_config_reg(REG_Raw_Data_Threshold, _rawDataThreshold);
+}
 
-  bool motion = (burstBuffer[0] & 0x80) != 0;
-  bool surface = (burstBuffer[0] & 0x08) == 0;   // 0 if on surface / 1 if off surface
+/*
+write_angle: write the rotation and angle snapping.
+*/
+void PMW3389::write_angle()
+{
+  write_config_reg(REG_Angle_Tune, static_cast<byte>(_angleTune));
+  write_config_reg(REG_Angle_Snap, _angleSnap ? ANGLE_SNAP_EN : 0x00);
+}
 
-  uint8_t xl = burstBuffer[2];    // dx LSB
-  uint8_t xh = burstBuffer[3];    // dx MSB
-  uint8_t yl = burstBuffer[4];    // dy LSB
-  uint8_t yh = burstBuffer[5];    // dy MSB
-  uint8_t sl = burstBuffer[10];   // shutter LSB
-  uint8_t sh = burstBuffer[11];   // shutter MSB
+/*
+write_power: write the rest schedule of the current power profile.
+  Config2 goes last so rest is only enabled with the schedule in place.
+*/
+void PMW3389::write_power()
+{
+  const POWER_PROFILE& profile = power_profiles[_power];
 
-  int x = xh<<8 | xl;
-  int y = yh<<8 | yl;
-  unsigned int shutter = sh<<8 | sl;
+  if(profile.config2 & CONFIG2_REST_EN)
+  {
+    write_config_reg(REG_Run_Downshift, profile.runDownshift);
+    write_config_reg(REG_Rest1_Rate_Lower, profile.rest1Rate & 0xff);
+    write_config_reg(REG_Rest1_Rate_Upper, profile.rest1Rate >> 8);
+    write_config_reg(REG_Rest1_Downshift, profile.rest1Downshift);
+    write_config_reg(REG_Rest2_Rate_Lower, profile.rest2Rate & 0xff);
+    write_config_reg(REG_Rest2_Rate_Upper, profile.rest2Rate >> 8);
+    write_config_reg(REG_Rest2_Downshift, profile.rest2Downshift);
+    write_config_reg(REG_Rest3_Rate_Lower, profile.rest3Rate & 0xff);
+    write_config_reg(REG_Rest3_Rate_Upper, profile.rest3Rate >> 8);
+  }
 
-  data.isMotion = motion;
-  data.isOnSurface = surface;
-  data.dx = x;
-  data.dy = y;
-  data.SQUAL = burstBuffer[6];
-  data.rawDataSum = burstBuffer[7];
-  data.maxRawData = burstBuffer[8];
-  data.minRawData = burstBuffer[9];
-  data.shutter = shutter;
+  write_config_reg(REG_Config2, config2());
+}
 
-  return data;
+/*
+clear_motion: read registers 0x02 to 0x06 (and discard the data)
+*/
+void PMW3389::clear_motion()
+{
+  adns_read_reg(REG_Motion);
+  adns_read_reg(REG_Delta_X_L);
+  adns_read_reg(REG_Delta_X_H);
+  adns_read_reg(REG_Delta_Y_L);
+  adns_read_reg(REG_Delta_Y_H);
 }
 
 // public
 /*
-readReg: get one byte value from the given reg_addr.
+readBurst: get one frame of motion data. Same as startBurst() followed by
+  pollBurst() until it completes, spinning through tSRAD.
 
-# parameter
-reg_addr: the register address
 # retrun
-byte value on the register.
+type: PMW3389_DATA, all zero if the burst was discarded
 */
-byte PMW3389::readReg(byte reg_addr)
+PMW3389_DATA PMW3389::readBurst()
 {
-  SPI_BEGIN;
-  byte data = adns_read_reg(reg_addr);
-  SPI_END;
+  PMW3389_DATA data = {};
+
+  startBurst();
+  while(_burstPending && !pollBurst(data))
+  {
+  }
+
   return data;
 }
 
 // public
 /*
-writeReg: write one byte value to the given reg_addr.
+startBurst: send the motion burst address and return immediately.
+  NCS stays low until pollBurst() reads the data, so the caller is free
+  to do other work during tSRAD. Call pollBurst() to finish the burst.
+  Burst mode is re-entered after register accesses and long pauses, which
+  is routine and only counted when a bad burst dropped it.
 
 # parameter
-reg_addr: the register address
-data: byte value to be pass to the register.
+isMotionSignalled: the burst was started because MOT was asserted.
 */
-void PMW3389::writeReg(byte reg_addr, byte data)
+void PMW3389::startBurst(bool isMotionSignalled)
 {
+  if(_burstPending)
+  {
+    return;
+  }
+
+  uint32_t fromLast = Hal::micros() - _lastBurst;
+
   SPI_BEGIN;
-  adns_write_reg(reg_addr, data);
-  SPI_END;
-}
 
-/*
-adns_read_reg: write one byte value to the given reg_addr.
-*/
-byte PMW3389::adns_read_reg(byte reg_addr) {
-  if(reg_addr != REG_Motion_Burst)
+  if(!_inBurst || fromLast > BURST_LAPSE)
   {
-     _inBurst = false;
+    if(_burstLost)
+    {
+      _health.resyncs++;
+      _burstLost = false;
+    }
+
+    adns_write_reg(REG_Motion_Burst, 0x00);
+    _inBurst = true;
   }
 
+  waitGuard(false);
   BEGIN_COM;
-  // send adress of the register, with MSBit = 0 to indicate it's a read
-  SPI.transfer(reg_addr & 0x7f );
-  delayMicroseconds(100); // tSRAD is 25, but 100us seems to be stable.
-  // read data
-  byte data = SPI.transfer(0);
+  Hal::spiTransfer(REG_Motion_Burst);
 
-  END_COM;
-  delayMicroseconds(19); //  tSRW/tSRR (=20us) minus tSCLK-NCS
+  SPI_END;
 
-  return data;
+  _burstStart = Hal::micros();
+  _burstPending = true;
+  _motionSignalled = isMotionSignalled;
 }
 
+// public
 /*
-adns_write_reg: write one byte value to the given reg_addr
+pollBurst: read the burst started by startBurst() if tSRAD has passed.
+
+# parameter
+data: receives the frame. untouched when returning false.
+# retrun
+true if the burst completed and passed checkBurst().
 */
-void PMW3389::adns_write_reg(byte reg_addr, byte data) {
-  if(reg_addr != REG_Motion_Burst)
+bool PMW3389::pollBurst(PMW3389_DATA& data)
+{
+  if(!finishBurst(&_diag, PMW3389_BURST_FULL))
   {
-    _inBurst = false;
+    return false;
   }
 
-  BEGIN_COM;
-  //send adress of the register, with MSBit = 1 to indicate it's a write
-  SPI.transfer(reg_addr | 0x80 );
-  //sent data
-  SPI.transfer(data);
-
-  delayMicroseconds(20); // tSCLK-NCS for write operation
-  END_COM;
-  delayMicroseconds(100); // tSWW/tSWR (=120us) minus tSCLK-NCS. Could be shortened, but is looks like a safe lower bound
+  decodeBurst(_diag, data);
+  return true;
 }
 
+// public
 /*
-adns_upload_firmware: load SROM content to the motion sensor
+pollBurst: like above, but clocks out only Motion, Observation and the
+  deltas, half of the full burst. Every Nth call (see
+  setDiagnosticInterval) reads the full burst into diagnostics() instead.
+
+# parameter
+motion: receives the motion bytes. zeroed if the burst was discarded.
+# retrun
+true if the burst completed and passed checkBurst().
 */
-void PMW3389::adns_upload_firmware() {
-  //Write 0 to Rest_En bit of Config2 register to disable Rest mode.
-  adns_write_reg(REG_Config2, 0x00);
+bool PMW3389::pollBurst(PMW3389_MOTION& motion)
+{
+  bool isFull = _diagInterval != 0 && _diagCount + 1 >= _diagInterval;
 
-  // write 0x1d in SROM_enable reg for initializing
-  adns_write_reg(REG_SROM_Enable, 0x1d);
+  if(!isFull)
+  {
+    if(!finishBurst(&motion, PMW3389_BURST_FAST))
+    {
+      return false;
+    }
+
+    _diagCount++;
+    return true;
+  }
 
-  // wait for more than one frame period
-  delay(10); // assume that the frame rate is as low as 100fps... even if it should never be that low
+  if(!finishBurst(&_diag, PMW3389_BURST_FULL))
+  {
+    return false;
+  }
 
-  // write 0x18 to SROM_enable to start SROM download
-  adns_write_reg(REG_SROM_Enable, 0x18);
+  _diagCount = 0;
+  motion = _diag.motion;
+  return true;
+}
 
-  // write the SROM file (=firmware data)
+// public
+/*
+pollBurst: read a burst cut to the bytes the caller needs. A full burst
+  also updates diagnostics().
 
-  BEGIN_COM;
-  SPI.transfer(REG_SROM_Load_Burst | 0x80); // write burst destination adress
-  delayMicroseconds(15);
+# parameter
+burst: receives the first `length` bytes. zeroed there if the burst was discarded.
+length: PMW3389_BURST_FAST to PMW3389_BURST_FULL
+# retrun
+true if the burst completed and passed checkBurst().
+*/
+bool PMW3389::pollBurst(PMW3389_BURST& burst, byte length)
+{
+  length = constrain(length, PMW3389_BURST_FAST, PMW3389_BURST_FULL);
 
-  // send all bytes of the firmware
-  unsigned char c;
-  for (int i = 0; i < firmware_length; i++) {
-    c = (unsigned char)pgm_read_byte(firmware_data + i);
-    SPI.transfer(c);
-    delayMicroseconds(15);
+  if(!finishBurst(&burst, length))
+  {
+    return false;
   }
 
-  //Read the SROM_ID register to verify the ID before any other register reads or writes.
-  adns_read_reg(REG_SROM_ID);
+  if(length == PMW3389_BURST_FULL)
+  {
+    _diag = burst;
+  }
+  return true;
+}
 
-  //Write 0x00 (rest disable) to Config2 register for wired mouse or 0x20 for wireless mouse design.
-  adns_write_reg(REG_Config2, 0x00);
+// public
+void PMW3389::setDiagnosticInterval(byte every)
+{
+  _diagInterval = every;
+  _diagCount = 0;
+}
 
-  END_COM;
+// public
+const PMW3389_BURST& PMW3389::diagnostics() const
+{
+  return _diag;
 }
 
 /*
-check_signature: check whether SROM is successfully loaded
-
-return: true if the rom is loaded correctly.
+finishBurst: clock `length` burst bytes into `buffer` if tSRAD has passed.
 */
-bool PMW3389::check_signature() {
-  SPI_BEGIN;
+bool PMW3389::finishBurst(void* buffer, byte length)
+{
+  if(!_burstPending)
+  {
+    return false;
+  }
 
-  byte pid = adns_read_reg(REG_Product_ID);
-  byte iv_pid = adns_read_reg(REG_Inverse_Product_ID);
-  byte SROM_ver = adns_read_reg(REG_SROM_ID);
+  if(Hal::micros() - _burstStart < T_SRAD_MOTBR + MICROS_STEP)
+  {
+    return false;
+  }
 
+  SPI_BEGIN;
+  Hal::spiTransfer(buffer, length); // read burst buffer
+  END_COM;
   SPI_END;
 
-  return (pid==0x42 && iv_pid == 0xBD && SROM_ver == 0x04); // signature for SROM 0x04
+  _burstPending = false;
+  markCom(COM_NONE); // only tBEXIT (500ns) is required after a burst
+  _lastBurst = Hal::micros();
+
+  if(!checkBurst(*static_cast<PMW3389_MOTION*>(buffer)))
+  {
+    memset(buffer, 0, length);
+    return false;
+  }
+
+  return true;
 }
 
 /*
-prepareImage: prepare a raw image capture from the snesor
+checkBurst: validate the Motion and Observation bytes of a burst. On a bad
+  burst, burst mode is dropped so the next startBurst() resyncs, and the
+  sensor is restarted if the SROM stopped or resyncing does not help. A
+  good burst without motion, started on MOT, counts as missed motion.
+
+# retrun
+true if the burst can be used.
 */
-void PMW3389::prepareImage()
+bool PMW3389::checkBurst(const PMW3389_MOTION& motion)
 {
-  SPI_BEGIN;
-
-  adns_write_reg(REG_Config2, 0x00);
+  if((motion.observation & OBSERVATION_SROM) == 0)
+  {
+    _health.sromLost++;
+    _health.restarts++;
+    start(_ss, _cpi, false);
+    return false;
+  }
 
-  adns_write_reg(REG_Frame_Capture, 0x83);
-  adns_write_reg(REG_Frame_Capture, 0xc5);
+  byte invalid = MOTION_RESERVED;
+  if(!(power_profiles[_power].config2 & CONFIG2_REST_EN))
+  {
+    invalid |= MOTION_OP_MODE;
+  }
 
-  delay(20);
+  if(motion.motion & invalid)
+  {
+    _health.garbageFrames++;
+    _inBurst = false;
+    _burstLost = true;
+
+    if(++_garbageRun >= GARBAGE_LIMIT)
+    {
+      _health.restarts++;
+      start(_ss, _cpi, false);
+    }
+    return false;
+  }
 
-  BEGIN_COM;
-  SPI.transfer(REG_Raw_Data_Burst & 0x7f);
-  delayMicroseconds(20);
+  _garbageRun = 0;
+  _health.frames++;
+  if(_motionSignalled && !(motion.motion & MOTION_MOT))
+  {
+    _health.missedMotion++;
+  }
+  trackWake(motion);
+  return true;
 }
+
 /*
-readImagePixel: prepare a raw image capture from the snesor
+trackWake: estimate wake up latency from the bursts after an idle gap.
+  The first burst after the gap carries all motion since the sensor woke
+  and noticed it; dividing its delta by the speed over the next few
+  bursts gives how long that motion had been building up.
 */
-byte PMW3389::readImagePixel()
+void PMW3389::trackWake(const PMW3389_MOTION& motion)
 {
-  byte pixel = SPI.transfer(0);
-  delayMicroseconds(20);
+  // 32 bit: int is 16 bit on AVR, where abs(-32768) overflows
+  uint32_t delta = abs(static_cast<int32_t>(motion.dx)) + abs(static_cast<int32_t>(motion.dy));
+  if(delta == 0)
+  {
+    _wakeBursts = 0;
+    return;
+  }
 
-  return pixel;
-}
+  uint32_t idleMs = (_lastBurst - _lastMotionAt) / 1000;
+  _lastMotionAt = _lastBurst;
 
-void PMW3389::endImage()
-{
-  END_COM;
-  SPI_END;
+  if(idleMs >= WAKE_IDLE_MS)
+  {
+    _wakeLevel = restLevelAfter(idleMs);
+    _wakeAt = _lastBurst;
+    _wakeFirst = delta;
+    _wakeRest = 0;
+    _wakeBursts = 1;
+    return;
+  }
+
+  if(_wakeBursts == 0)
+  {
+    return;
+  }
+
+  if(_lastBurst - _wakeAt > WAKE_WINDOW)
+  {
+    _wakeBursts = 0;
+    return;
+  }
+
+  _wakeRest += delta;
+  if(_wakeBursts++ < WAKE_BURSTS)
+  {
+    return;
+  }
+
+  // speed in counts/us over the follow-up bursts, latency = first / speed
+  uint32_t latency = static_cast<uint32_t>(
+    static_cast<uint64_t>(_wakeFirst) * (_lastBurst - _wakeAt) / _wakeRest);
+
+  PMW3389_WAKE& stats = _wake[_wakeLevel];
+  if(stats.count < 0xffff)
+  {
+    stats.count++;
+    stats.totalMus += latency;
+  }
+  stats.maxMus = max(stats.maxMus, latency);
+  _wakeBursts = 0;
+}
+
+/*
+restLevelAfter: the rest level the sensor reaches after idling for
+  idleMs under the current power profile. 0 is run mode.
+*/
+byte PMW3389::restLevelAfter(uint32_t idleMs) const
+{
+  const POWER_PROFILE& profile = power_profiles[_power];
+  if(!(profile.config2 & CONFIG2_REST_EN))
+  {
+    return 0;
+  }
+
+  uint32_t until = profile.runDownshift * 10UL;
+  if(idleMs < until)
+  {
+    return 0;
+  }
+
+  until += profile.rest1Downshift * 320UL * (profile.rest1Rate + 1UL);
+  if(idleMs < until)
+  {
+    return 1;
+  }
+
+  until += profile.rest2Downshift * 32UL * (profile.rest2Rate + 1UL);
+  if(idleMs < until)
+  {
+    return 2;
+  }
+
+  return 3;
+}
+
+// public
+bool PMW3389::isBurstPending() const
+{
+  return _burstPending;
+}
+
+// public
+/*
+setLiftConfig: set the lift detection height. bits 1:0, 0x02 is 2 mm and
+  0x03 is 3 mm.
+*/
+void PMW3389::setLiftConfig(byte liftConfig)
+{
+  if(liftConfig == _liftConfig)
+  {
+    return;
+  }
+
+  _liftConfig = liftConfig;
+
+  if(isReady())
+  {
+    SPI_BEGIN;
+    write_config_reg(REG_Lift_Config, _liftConfig);
+    SPI_END;
+  }
+}
+
+// public
+/*
+setMinSQRun: set the minimum SQUAL for the sensor to report motion.
+*/
+void PMW3389::setMinSQRun(byte minSQRun)
+{
+  if(minSQRun == _minSQRun)
+  {
+    return;
+  }
+
+  _minSQRun = minSQRun;
+
+  if(isReady())
+  {
+    SPI_BEGIN;
+    write_config_reg(REG_Min_SQ_Run, _minSQRun);
+    SPI_END;
+  }
+}
+
+// public
+/*
+setRawDataThreshold: set the raw data level that counts as a feature
+  for SQUAL.
+*/
+void PMW3389::setRawDataThreshold(byte threshold)
+{
+  if(threshold == _rawDataThreshold)
+  {
+    return;
+  }
+
+  _rawDataThreshold = threshold;
+
+  if(isReady())
+  {
+    SPI_BEGIN;
+    write_config_reg(REG_Raw_Data_Threshold, _rawDataThreshold);
+    SPI_END;
+  }
+}
+
+// public
+/*
+setAngleTune: rotate the sensor's X/Y axes to make up for a rotated
+  mount. The sensor applies it to every frame, positive is clockwise.
+
+# parameter
+degrees: -30 to 30
+*/
+void PMW3389::setAngleTune(int8_t degrees)
+{
+  degrees = constrain(degrees, -ANGLE_TUNE_MAX, ANGLE_TUNE_MAX);
+  if(degrees == _angleTune)
+  {
+    return;
+  }
+
+  _angleTune = degrees;
+
+  if(isReady())
+  {
+    SPI_BEGIN;
+    write_angle();
+    SPI_END;
+  }
+}
+
+// public
+int8_t PMW3389::getAngleTune() const
+{
+  return _angleTune;
+}
+
+// public
+/*
+setAngleSnap: make the sensor snap motion close to horizontal or
+  vertical onto that axis.
+*/
+void PMW3389::setAngleSnap(bool isEnabled)
+{
+  if(isEnabled == _angleSnap)
+  {
+    return;
+  }
+
+  _angleSnap = isEnabled;
+
+  if(isReady())
+  {
+    SPI_BEGIN;
+    write_angle();
+    SPI_END;
+  }
+}
+
+// public
+bool PMW3389::getAngleSnap() const
+{
+  return _angleSnap;
+}
+
+// public
+/*
+setPowerProfile: select how the sensor downshifts into rest modes when
+  idle. Written right away if the sensor is ready, otherwise at the end
+  of bring-up.
+*/
+void PMW3389::setPowerProfile(PMW3389_POWER profile)
+{
+  if(profile >= PMW3389_POWER_COUNT || profile == _power)
+  {
+    return;
+  }
+
+  _power = profile;
+  _wakeBursts = 0;
+
+  if(isReady())
+  {
+    SPI_BEGIN;
+    write_power();
+    SPI_END;
+  }
+}
+
+// public
+PMW3389_POWER PMW3389::getPowerProfile() const
+{
+  return _power;
+}
+
+// public
+const PMW3389_WAKE& PMW3389::wakeStats(byte level) const
+{
+  return _wake[min(level, PMW3389_REST_LEVELS - 1)];
+}
+
+// public
+void PMW3389::resetWakeStats()
+{
+  memset(_wake, 0, sizeof(_wake));
+  _wakeBursts = 0;
+}
+
+// public
+const PMW3389_HEALTH& PMW3389::health() const
+{
+  return _health;
+}
+
+// public
+void PMW3389::resetHealth()
+{
+  _health = {};
+}
+
+/*
+cancelBurst: release NCS if a burst was started but never read.
+*/
+void PMW3389::cancelBurst()
+{
+  if(_burstPending)
+  {
+    END_COM;
+    _burstPending = false;
+    _inBurst = false;
+  }
+}
+
+/*
+decodeBurst: unpack a full motion burst into PMW3389_DATA.
+*/
+void PMW3389::decodeBurst(const PMW3389_BURST& burst, PMW3389_DATA& data)
+{
+  data.isMotion = (burst.motion.motion & 0x80) != 0;
+  data.isOnSurface = (burst.motion.motion & 0x08) == 0;   // 0 if on surface / 1 if off surface
+  data.dx = burst.motion.dx;
+  data.dy = burst.motion.dy;
+  data.SQUAL = burst.SQUAL;
+  data.rawDataSum = burst.rawDataSum;
+  data.maxRawData = burst.maxRawData;
+  data.minRawData = burst.minRawData;
+  data.shutter = burst.shutterUpper<<8 | burst.shutterLower;
+}
+
+// public
+/*
+readReg: get one byte value from the given reg_addr.
+
+# parameter
+reg_addr: the register address
+# retrun
+byte value on the register.
+*/
+byte PMW3389::readReg(byte reg_addr)
+{
+  SPI_BEGIN;
+  byte data = adns_read_reg(reg_addr);
+  SPI_END;
+  return data;
+}
+
+// public
+/*
+refresh: read the configuration registers back from the chip into the
+  shadow, e.g. after writing them behind the driver's back.
+*/
+void PMW3389::refresh()
+{
+  _shadowValid = 0;
+
+  if(!isReady())
+  {
+    return;
+  }
+
+  SPI_BEGIN;
+  for(byte i = 0; i < PMW3389_SHADOW_REGS; i++)
+  {
+    adns_read_reg(shadow_regs[i]);
+  }
+  SPI_END;
+}
+
+/*
+shadow_slot: index of reg_addr in the register shadow, -1 if not shadowed.
+*/
+int8_t PMW3389::shadow_slot(byte reg_addr) const
+{
+  for(byte i = 0; i < PMW3389_SHADOW_REGS; i++)
+  {
+    if(shadow_regs[i] == reg_addr)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*
+read_config_reg: read a register, from the shadow if it holds it.
+*/
+byte PMW3389::read_config_reg(byte reg_addr)
+{
+  int8_t slot = shadow_slot(reg_addr);
+  if(slot >= 0 && (_shadowValid & (1UL << slot)))
+  {
+    return _shadow[slot];
+  }
+  return adns_read_reg(reg_addr);
+}
+
+/*
+write_config_reg: write a register unless the shadow shows it already
+  holds data.
+*/
+void PMW3389::write_config_reg(byte reg_addr, byte data)
+{
+  int8_t slot = shadow_slot(reg_addr);
+  if(slot >= 0 && (_shadowValid & (1UL << slot)) && _shadow[slot] == data)
+  {
+    return;
+  }
+  adns_write_reg(reg_addr, data);
+}
+
+// public
+/*
+writeReg: write one byte value to the given reg_addr.
+
+# parameter
+reg_addr: the register address
+data: byte value to be pass to the register.
+*/
+void PMW3389::writeReg(byte reg_addr, byte data)
+{
+  SPI_BEGIN;
+  adns_write_reg(reg_addr, data);
+  SPI_END;
+}
+
+/*
+adns_read_reg: read one byte value from the given reg_addr.
+*/
+byte PMW3389::adns_read_reg(byte reg_addr) {
+  cancelBurst();
+
+  if(reg_addr != REG_Motion_Burst)
+  {
+     _inBurst = false;
+  }
+
+  waitGuard(false);
+
+  BEGIN_COM;
+  // send adress of the register, with MSBit = 0 to indicate it's a read
+  Hal::spiTransfer(reg_addr & 0x7f );
+  Hal::delayMicros(T_SRAD);
+  // read data
+  byte data = Hal::spiTransfer(0);
+
+  END_COM;
+  markCom(COM_READ);
+
+  int8_t slot = shadow_slot(reg_addr);
+  if(slot >= 0)
+  {
+    _shadow[slot] = data;
+    _shadowValid |= 1UL << slot;
+  }
+
+  return data;
+}
+
+/*
+adns_write_reg: write one byte value to the given reg_addr
+*/
+void PMW3389::adns_write_reg(byte reg_addr, byte data) {
+  cancelBurst();
+
+  if(reg_addr != REG_Motion_Burst)
+  {
+    _inBurst = false;
+  }
+
+  waitGuard(true);
+
+  BEGIN_COM;
+  //send adress of the register, with MSBit = 1 to indicate it's a write
+  Hal::spiTransfer(reg_addr | 0x80 );
+  //sent data
+  Hal::spiTransfer(data);
+  markCom(COM_WRITE);
+
+  Hal::delayMicros(T_SCLK_NCS_WR);
+  END_COM;
+
+  if(reg_addr == REG_Power_Up_Reset)
+  {
+    _shadowValid = 0;
+    return;
+  }
+
+  int8_t slot = shadow_slot(reg_addr);
+  if(slot >= 0)
+  {
+    _shadow[slot] = data;
+    _shadowValid |= 1UL << slot;
+  }
+}
+
+/*
+waitGuard: stall only as long as the datasheet requires since the last
+  register access. tSWW/tSWR/tSRW/tSRR are counted from the last clock
+  edge of the previous access, so time spent elsewhere is not wasted.
+*/
+void PMW3389::waitGuard(bool isWrite) {
+  unsigned int guard = 0;
+  if(_lastComKind == COM_WRITE)
+  {
+    guard = isWrite ? T_SWW : T_SWR;
+  }
+  else if(_lastComKind == COM_READ)
+  {
+    guard = isWrite ? T_SRW : T_SRR;
+  }
+  else
+  {
+    return;
+  }
+
+  while(Hal::micros() - _lastCom < guard + MICROS_STEP)
+  {
+  }
+}
+
+/*
+markCom: remember when the last register access ended and what it was.
+*/
+void PMW3389::markCom(byte kind) {
+  _lastCom = Hal::micros();
+  _lastComKind = kind;
+}
+
+// public
+/*
+beginBatch: keep one SPI transaction open across several calls, e.g.
+  setCPI() followed by other configuration writes. Must be paired with
+  endBatch(). Batches may nest.
+*/
+void PMW3389::beginBatch()
+{
+  SPI_BEGIN;
+}
+
+// public
+void PMW3389::endBatch()
+{
+  SPI_END;
+}
+
+/*
+beginTransaction: open the SPI transaction unless one is already open.
+*/
+void PMW3389::beginTransaction()
+{
+  if(_txDepth++ == 0)
+  {
+    Hal::spiBeginTransaction(8000000);
+  }
+}
+
+/*
+endTransaction: close the SPI transaction when the outermost user is done.
+*/
+void PMW3389::endTransaction()
+{
+  if(_txDepth > 0 && --_txDepth == 0)
+  {
+    Hal::spiEndTransaction();
+  }
+}
+
+/*
+upload_firmware_chunk: send the next SROM_CHUNK bytes of the SROM.
+  the next byte is fetched from flash before the tLOAD gap so the gap is
+  the only time between transfers.
+*/
+void PMW3389::upload_firmware_chunk() {
+  unsigned int end = min(_sromPos + SROM_CHUNK, (unsigned int)firmware_length);
+
+  unsigned char c = (unsigned char)Hal::flashByte(firmware_data + _sromPos);
+  while(_sromPos < end) {
+    Hal::delayMicros(T_LOAD);
+    Hal::spiTransfer(c);
+    _sromPos++;
+    if (_sromPos < end) {
+      c = (unsigned char)Hal::flashByte(firmware_data + _sromPos);
+    }
+  }
+}
+
+/*
+hasElapsed: true once at least `us` microseconds have passed since `since`.
+*/
+bool PMW3389::hasElapsed(uint32_t since, uint32_t us) {
+  return Hal::micros() - since >= us + MICROS_STEP;
+}
+
+/*
+check_signature: check whether SROM is successfully loaded
+
+return: true if the rom is loaded correctly.
+*/
+bool PMW3389::check_signature() {
+  SPI_BEGIN;
+
+  byte pid = adns_read_reg(REG_Product_ID);
+  byte iv_pid = adns_read_reg(REG_Inverse_Product_ID);
+  byte SROM_ver = adns_read_reg(REG_SROM_ID);
+
+  SPI_END;
+
+  return (pid==0x42 && iv_pid == 0xBD && SROM_ver == 0x04); // signature for SROM 0x04
+}
+
+// public
+/*
+startCapture: stop navigation and latch one raw frame for readCapture().
+  Frame_Capture leaves the sensor without a running SROM, so it is
+  restarted once the whole frame has been read.
+*/
+void PMW3389::startCapture()
+{
+  if(_state != PMW3389_READY)
+  {
+    return;
+  }
+
+  SPI_BEGIN;
+  adns_write_reg(REG_Config2, 0x00);
+  adns_write_reg(REG_Frame_Capture, 0x83);
+  adns_write_reg(REG_Frame_Capture, 0xc5);
+  SPI_END;
+
+  _capturePos = 0;
+  _phaseAt = Hal::micros();
+  _state = PMW3389_CAPTURE_WAIT;
+}
+
+// public
+/*
+readCapture: continue the raw data burst started by startCapture().
+  Pixels are clocked out tLOAD apart, the fastest the datasheet allows.
+  Returns without blocking while the frame or tSRAD is still pending.
+
+# parameter
+pixels: receives the next pixels of the 36x36 frame, row by row
+length: size of pixels
+# retrun
+number of pixels written. 0 while waiting or when no capture is running.
+*/
+size_t PMW3389::readCapture(byte* pixels, size_t length)
+{
+  if(_state == PMW3389_CAPTURE_WAIT)
+  {
+    if(!hasElapsed(_phaseAt, T_FRAME_CAPTURE))
+    {
+      return 0;
+    }
+
+    SPI_BEGIN;
+    waitGuard(false);
+    BEGIN_COM;
+    Hal::spiTransfer(REG_Raw_Data_Burst);
+    SPI_END;
+
+    _phaseAt = Hal::micros();
+    _state = PMW3389_CAPTURE;
+    return 0;
+  }
+
+  if(_state != PMW3389_CAPTURE)
+  {
+    return 0;
+  }
+
+  if(_capturePos == 0 && !hasElapsed(_phaseAt, T_SRAD))
+  {
+    return 0;
+  }
+
+  size_t count = min(length, static_cast<size_t>(PMW3389_FRAME_PIXELS - _capturePos));
+
+  SPI_BEGIN;
+  for(size_t i = 0; i < count; i++)
+  {
+    if(_capturePos > 0)
+    {
+      Hal::delayMicros(T_LOAD);
+    }
+    pixels[i] = Hal::spiTransfer(0);
+    _capturePos++;
+  }
+
+  if(_capturePos >= PMW3389_FRAME_PIXELS)
+  {
+    END_COM;
+    markCom(COM_READ);
+    SPI_END;
+    start(_ss, _cpi, false);
+    return count;
+  }
+
+  SPI_END;
+  return count;
+}
+
+// public
+bool PMW3389::isCapturing() const
+{
+  return _state == PMW3389_CAPTURE_WAIT || _state == PMW3389_CAPTURE;
 }
@@ -530,8 +530,7 @@
 #ifndef PMW3389_LIB
 #define PMW3389_LIB
 
-#include <Arduino.h>
-#include <SPI.h>
+#include "Hal.h"
 
 // Registers
 #define REG_Product_ID  0x00
@@ -589,7 +588,10 @@ Raw burst data structure:
   BYTE[00] = Motion    = if the 7th bit is 1, a motion is detected.
          ==> 7 bit: MOT (1 when motion is detected)
          ==> 3 bit: 0 when chip is on surface / 1 when off surface
+         ==> 2-1 bit: operation mode, 00 in run mode, 01-11 rest1-3
+         ==> 6-4 and 0 bit: always 0 in a burst
   BYTE[01] = Observation
+         ==> 6 bit: SROM_RUN (1 while the SROM is running)
   BYTE[02] = Delta_X_L = dx (LSB)
   BYTE[03] = Delta_X_H = dx (MSB)
   BYTE[04] = Delta_Y_L = dy (LSB)
@@ -600,8 +602,16 @@ Raw burst data structure:
                              * Avg value = Raw_Data_Sum * 1024 / 1296
   BYTE[08] = Maximum_Raw_Data  = Max raw data value in current frame, max=127
   BYTE[09] = Minimum_Raw_Data  = Min raw data value in current frame, max=127
-  BYTE[10] = Shutter_Upper     = Shutter LSB
-  BYTE[11] = Shutter_Lower     = Shutter MSB, Shutter = shutter is adjusted to keep the average raw data values within normal operating ranges
+  BYTE[10] = Shutter_Upper     = Shutter MSB
+  BYTE[11] = Shutter_Lower     = Shutter LSB, Shutter = shutter is adjusted to keep the average raw data values within normal operating ranges
+
+A burst may be cut short by raising NCS. BYTE[00..05] is all that is
+needed for motion (PMW3389_BURST_FAST); BYTE[06..11] are diagnostics.
+
+Every burst is checked before it is returned: a Motion byte with reserved
+bits set, or a rest mode while rest is disabled, is garbage, and so is an
+Observation byte without SROM_RUN. Such bursts are dropped and counted in
+PMW3389_HEALTH.
 
 Struct description
 - PMW3389_DATA.isMotion      : bool, True if a motion is detected.
@@ -621,8 +631,8 @@ struct PMW3389_DATA
 {
  bool isMotion;        // True if a motion is detected.
  bool isOnSurface;     // True when a chip is on a surface
- int dx;               // displacement on x directions. Unit: Count. (CPI * Count = Inch value)
- int dy;               // displacement on y directions.
+ int32_t dx;           // displacement on x directions. Unit: Count. (CPI * Count = Inch value)
+ int32_t dy;           // displacement on y directions.
  byte SQUAL;           // Surface Quality register, max 0x80. Number of features on the surface = SQUAL * 8
  byte rawDataSum;      // It reports the upper byte of an 18‐bit counter which sums all 1296 raw data in the current frame; * Avg value = Raw_Data_Sum * 1024 / 1296
  byte maxRawData;      // Max raw data value in current frame, max=127
@@ -630,30 +640,240 @@ struct PMW3389_DATA
  unsigned int shutter; // unit: clock cycles of the internal oscillator. shutter is adjusted to keep the average raw data values within normal operating ranges.
 };
 
+// bring-up progress, advanced by PMW3389::step()
+enum PMW3389_STATE : byte
+{
+  PMW3389_OFF,
+  PMW3389_WARM_CHECK,   // probing for a running SROM
+  PMW3389_WARM_CRC,     // waiting for the SROM CRC self test
+  PMW3389_RESET,        // about to power cycle the chip
+  PMW3389_RESET_WAIT,   // waiting for the chip to reboot
+  PMW3389_SROM_INIT,    // waiting after SROM_Enable 0x1d
+  PMW3389_SROM_LOAD,    // uploading the SROM, NCS held low
+  PMW3389_SROM_EXIT,    // waiting before the SROM_ID check
+  PMW3389_CONFIG,       // applying configuration
+  PMW3389_READY,
+  PMW3389_CAPTURE_WAIT, // Frame_Capture started, waiting for the frame
+  PMW3389_CAPTURE,      // raw data burst in progress, NCS held low
+};
+
+#define PMW3389_FRAME_SIDE    36
+#define PMW3389_FRAME_PIXELS  (PMW3389_FRAME_SIDE * PMW3389_FRAME_SIDE)
+
+// microseconds spent in each phase of sensor bring-up
+struct PMW3389_BOOT_TIMING
+{
+  bool isWarm;              // true if the running SROM was reused
+  uint32_t resetMus;   // warm check, or shutdown, power up reset and motion register clear
+  uint32_t sromMus;    // SROM download and SROM_ID check
+  uint32_t configMus;  // CPI and signature check
+  uint32_t totalMus;
+};
+
+#define PMW3389_BURST_FAST  6   // Motion, Observation, Delta_X, Delta_Y
+#define PMW3389_BURST_FULL  12  // everything, including SQUAL and shutter
+
+/*
+PMW3389_MOTION/PMW3389_BURST mirror the burst bytes exactly. Deltas come
+off the bus little endian, the same as AVR, so a burst is read straight
+into the struct and needs no decoding.
+*/
+struct __attribute__((packed)) PMW3389_MOTION
+{
+  uint8_t motion;       // BYTE[00], see Motion register
+  uint8_t observation;  // BYTE[01]
+  int16_t dx;           // BYTE[02..03]
+  int16_t dy;           // BYTE[04..05]
+};
+
+struct __attribute__((packed)) PMW3389_BURST
+{
+  PMW3389_MOTION motion;
+  uint8_t SQUAL;        // BYTE[06]
+  uint8_t rawDataSum;   // BYTE[07]
+  uint8_t maxRawData;   // BYTE[08]
+  uint8_t minRawData;   // BYTE[09]
+  uint8_t shutterUpper; // BYTE[10]
+  uint8_t shutterLower; // BYTE[11]
+};
+
+// burst health counters since power on, see PMW3389::health()
+struct PMW3389_HEALTH
+{
+  uint32_t frames;        // bursts accepted
+  uint32_t garbageFrames; // bursts discarded for invalid Motion bits
+  uint32_t sromLost;      // bursts discarded because SROM_RUN was clear
+  uint32_t resyncs;       // burst mode re-entered after a bad burst dropped it
+  uint32_t missedMotion;  // MOT was asserted but the burst read no motion
+  uint32_t restarts;      // sensor restarted after SROM loss or repeated garbage
+};
+
+// rest mode schedules, programmed through Config2 and the Run/Rest registers
+enum PMW3389_POWER : byte
+{
+  PMW3389_POWER_PERFORMANCE, // rest disabled, lowest latency
+  PMW3389_POWER_BALANCED,    // rest after 500 ms, shallow rest levels
+  PMW3389_POWER_BATTERY,     // rest after 100 ms, deep rest levels
+  PMW3389_POWER_COUNT,
+};
+
+#define PMW3389_REST_LEVELS 4  // run, rest1, rest2, rest3
+
+/*
+PMW3389_WAKE: how long motion had been going on before the first burst
+  reported it, after the sensor idled in a given rest level. Estimated
+  from the first burst's delta and the speed over the bursts after it.
+*/
+struct PMW3389_WAKE
+{
+  uint16_t count;
+  uint32_t totalMus;
+  uint32_t maxMus;
+};
+
+static_assert(sizeof(PMW3389_MOTION) == PMW3389_BURST_FAST, "burst layout");
+static_assert(sizeof(PMW3389_BURST) == PMW3389_BURST_FULL, "burst layout");
+
+// configuration registers mirrored in RAM, see PMW3389::refresh()
+#define PMW3389_SHADOW_REGS 17
+
 class PMW3389
 {
 public:
   PMW3389();  // set CPI to 800 by default.
   // begin: initialize the module, ss_pin: slave select pin, CPI: initial Count Per Inch
-  bool begin(unsigned int ss_pin, unsigned int CPI = 800);
-  // setCPI: set Count Per Inch value
+  bool begin(unsigned int ss_pin, unsigned int CPI = 800, bool allowWarmStart = true);
+  // start/step: non-blocking begin(). call step() until it returns true
+  void start(unsigned int ss_pin, unsigned int CPI = 800, bool allowWarmStart = true);
+  bool step();
+  bool isReady() const;
+  PMW3389_STATE state() const;
+  // bootTiming: per-phase duration of the last begin()
+  const PMW3389_BOOT_TIMING& bootTiming() const;
+  // setCPI: set Count Per Inch value, both axes
   void setCPI(unsigned int newCPI);
-  // setCPI: get CPI value (it does read CPI register from the module)
+  // setCPI: separate X and Y resolution, through Config5
+  void setCPI(unsigned int cpiX, unsigned int cpiY);
+  // getCPI/getCPIY: X/Y CPI value (from the register shadow once ready)
   unsigned int getCPI();
+  unsigned int getCPIY();
+  // readBurst: blocking startBurst() + pollBurst(), for callers with nothing to overlap
   PMW3389_DATA readBurst();
+  // startBurst: select the sensor and request a motion burst without waiting for tSRAD.
+  // isMotionSignalled: started because MOT was asserted, so a burst without motion is a fault
+  void startBurst(bool isMotionSignalled = false);
+  // pollBurst: finish a started burst once tSRAD has passed. false while still waiting
+  bool pollBurst(PMW3389_DATA& data);
+  // pollBurst: fast variant, reads only the 6 motion bytes except on diagnostic frames
+  bool pollBurst(PMW3389_MOTION& motion);
+  // pollBurst: read only the first `length` burst bytes (6 to 12), the rest is left as is
+  bool pollBurst(PMW3389_BURST& burst, byte length);
+  // setDiagnosticInterval: read the full burst on every Nth fast poll. 0 never does
+  void setDiagnosticInterval(byte every);
+  // diagnostics: the last full burst, from either pollBurst variant
+  const PMW3389_BURST& diagnostics() const;
+  // isBurstPending: true between startBurst() and the pollBurst() that completes it
+  bool isBurstPending() const;
+  // setLiftConfig/setMinSQRun/setRawDataThreshold: surface detection tuning,
+  //   written once the sensor is ready. see REG_Lift_Config etc.
+  void setLiftConfig(byte liftConfig);
+  void setMinSQRun(byte minSQRun);
+  void setRawDataThreshold(byte threshold);
+  // setAngleTune: rotate the motion reported by the sensor, -30 to 30 degrees
+  void setAngleTune(int8_t degrees);
+  int8_t getAngleTune() const;
+  // setAngleSnap: snap near horizontal/vertical motion to the axis
+  void setAngleSnap(bool isEnabled);
+  bool getAngleSnap() const;
+  // setPowerProfile: select a rest mode schedule, written once the sensor is ready
+  void setPowerProfile(PMW3389_POWER profile);
+  PMW3389_POWER getPowerProfile() const;
+  // wakeStats: wake up latency by the rest level the sensor idled in, 0 is run mode
+  const PMW3389_WAKE& wakeStats(byte level) const;
+  void resetWakeStats();
+  // health: counters of discarded bursts and burst mode recoveries
+  const PMW3389_HEALTH& health() const;
+  void resetHealth();
   byte readReg(byte reg_addr);
   void writeReg(byte reg_addr, byte data);
-  void prepareImage();
-  byte readImagePixel();
-  void endImage();
+  // refresh: reload the configuration register shadow from the chip
+  void refresh();
+  // beginBatch/endBatch: share one SPI transaction across several register accesses
+  void beginBatch();
+  void endBatch();
+  // startCapture: stop navigation and grab one raw frame. needs isReady()
+  void startCapture();
+  // readCapture: read up to `length` pixels, row by row. 0 while waiting for the frame.
+  //   the sensor restarts after the last pixel, call step() until it is ready again
+  size_t readCapture(byte* pixels, size_t length);
+  bool isCapturing() const;
 
 private:
   unsigned int _ss;
   bool _inBurst = false;
-  unsigned long _lastBurst = 0;
+  uint32_t _lastBurst = 0;
+  bool _burstPending = false;
+  uint32_t _burstStart = 0;
+  enum : byte { COM_NONE, COM_READ, COM_WRITE };
+  uint32_t _lastCom = 0;     // micros() at the last clock edge of a register access
+  byte _lastComKind = COM_NONE;
+  byte _txDepth = 0;
+  PMW3389_STATE _state = PMW3389_OFF;
+  unsigned int _cpi = 800;
+  unsigned int _cpiY = 800;
+  bool _signatureOk = false;
+  unsigned int _sromPos = 0;
+  unsigned int _capturePos = 0;
+  uint32_t _phaseAt = 0;     // start of the current bring-up wait
+  uint32_t _bootStart = 0;
+  uint32_t _sromStart = 0;
+  uint32_t _configStart = 0;
+  PMW3389_BOOT_TIMING _bootTiming = {};
+  void cancelBurst();
+  void waitGuard(bool isWrite);
+  void markCom(byte kind);
+  bool hasElapsed(uint32_t since, uint32_t us);
+  void beginTransaction();
+  void endTransaction();
+  byte _diagInterval = 0;
+  byte _diagCount = 0;
+  PMW3389_BURST _diag = {};
+  PMW3389_HEALTH _health = {};
+  bool _burstLost = false;   // burst mode was dropped by a bad burst
+  bool _motionSignalled = false; // the pending burst was started on MOT
+  byte _garbageRun = 0;      // consecutive discarded bursts
+  byte _shadow[PMW3389_SHADOW_REGS] = {};
+  uint32_t _shadowValid = 0; // bit per _shadow entry
+  int8_t shadow_slot(byte reg_addr) const;
+  byte read_config_reg(byte reg_addr);
+  void write_config_reg(byte reg_addr, byte data);
+  byte _liftConfig = 0x02;   // power up values
+  byte _minSQRun = 0x10;
+  byte _rawDataThreshold = 0x0a;
+  void write_surface();
+  int8_t _angleTune = 0;
+  bool _angleSnap = false;
+  void write_angle();
+  PMW3389_POWER _power = PMW3389_POWER_PERFORMANCE;
+  PMW3389_WAKE _wake[PMW3389_REST_LEVELS] = {};
+  uint32_t _lastMotionAt = 0; // burst time of the last burst with motion
+  byte _wakeLevel = 0;
+  byte _wakeBursts = 0;      // bursts seen since the wake burst, 0 if not measuring
+  uint32_t _wakeAt = 0;
+  uint32_t _wakeFirst = 0;   // |dx| + |dy| of the wake burst
+  uint32_t _wakeRest = 0;    // |dx| + |dy| of the bursts after it
+  void trackWake(const PMW3389_MOTION& motion);
+  byte restLevelAfter(uint32_t idleMs) const;
+  void write_power();
+  byte config2() const;
+  bool checkBurst(const PMW3389_MOTION& motion);
+  bool finishBurst(void* buffer, byte length);
+  void decodeBurst(const PMW3389_BURST& burst, PMW3389_DATA& data);
   byte adns_read_reg(byte reg_addr);
   void adns_write_reg(byte reg_addr, byte data);
-  void adns_upload_firmware();
+  void upload_firmware_chunk();
+  void write_cpi();
+  void clear_motion();
   bool check_signature();
 };
 //extern AdvMouse_ AdvMouse;
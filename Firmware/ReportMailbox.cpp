@@ -0,0 +1,123 @@
+#include "HID.h"
+#include "ReportMailbox.h"
+
+namespace {
+  constexpr int32_t report_max = 32767;
+  constexpr uint8_t report_id = 0x01;
+
+  // boot protocol reports have no ID and 8 bit X and Y
+  constexpr uint8_t boot_report_id = 0x00;
+  constexpr int16_t boot_report_max = 127;
+
+  auto clampBoot(int16_t value) -> int8_t {
+    if (value > boot_report_max) {
+      return boot_report_max;
+    }
+    if (value < -boot_report_max) {
+      return -boot_report_max;
+    }
+    return static_cast<int8_t>(value);
+  }
+
+  auto sendReport(const MouseReport& report) -> int {
+    uint8_t payload[] = {
+      report.buttons,
+      static_cast<uint8_t>(report.x & 0xff),
+      static_cast<uint8_t>((report.x >> 8) & 0xff),
+      static_cast<uint8_t>(report.y & 0xff),
+      static_cast<uint8_t>((report.y >> 8) & 0xff),
+      static_cast<uint8_t>(report.wheel & 0xff),
+      static_cast<uint8_t>((report.wheel >> 8) & 0xff),
+      static_cast<uint8_t>(report.pan & 0xff),
+      static_cast<uint8_t>((report.pan >> 8) & 0xff),
+    };
+    return HID().SendReport(report_id, payload, sizeof(payload));
+  }
+
+  // sends as much of report's motion as fits and takes it out of report.
+  // there is no wheel in the boot layout, so scrolling is dropped
+  auto sendBootReport(MouseReport& report) -> int {
+    int8_t x = clampBoot(report.x);
+    int8_t y = clampBoot(report.y);
+    uint8_t payload[] = {
+      report.buttons,
+      static_cast<uint8_t>(x),
+      static_cast<uint8_t>(y),
+    };
+
+    int ret = HID().SendReport(boot_report_id, payload, sizeof(payload));
+    if (ret > 0) {
+      report.x = static_cast<int16_t>(report.x - x);
+      report.y = static_cast<int16_t>(report.y - y);
+      report.wheel = 0;
+      report.pan = 0;
+    }
+    return ret;
+  }
+
+  // adds value to field up to the report range, leaving the rest in value
+  void mergeField(int16_t& field, int16_t& value) {
+    int32_t sum = static_cast<int32_t>(field) + value;
+    if (sum > report_max) {
+      sum = report_max;
+    } else if (sum < -report_max) {
+      sum = -report_max;
+    }
+    value = static_cast<int16_t>(value - (sum - field));
+    field = static_cast<int16_t>(sum);
+  }
+}  // namespace
+
+
+auto ReportMailbox::publish(MouseReport& report) -> bool {
+  if (count == 0 || slots[count - 1].buttons != report.buttons) {
+    if (count == slot_count) {
+      return false;
+    }
+
+    slots[count++] = report;
+    report.x = 0;
+    report.y = 0;
+    report.wheel = 0;
+    report.pan = 0;
+    return true;
+  }
+
+  MouseReport& newest = slots[count - 1];
+  mergeField(newest.x, report.x);
+  mergeField(newest.y, report.y);
+  mergeField(newest.wheel, report.wheel);
+  mergeField(newest.pan, report.pan);
+  return true;
+}
+
+auto ReportMailbox::flush(uint8_t maxReports) -> bool {
+  bool isBoot = HID().IsBootProtocol();
+
+  for (; count > 0 && maxReports > 0; maxReports--) {
+    MouseReport& oldest = slots[0];
+    int ret = isBoot ? sendBootReport(oldest) : sendReport(oldest);
+
+    // 0 is a busy endpoint, keep the report. an error drops it, otherwise
+    // a stalled bus would freeze the buttons at this state forever
+    if (ret == 0) {
+      return false;
+    }
+
+    // a large move takes several boot reports, split rather than clipped
+    if (isBoot && ret > 0 && (oldest.x != 0 || oldest.y != 0)) {
+      continue;
+    }
+
+    for (uint8_t i = 1; i < count; i++) {
+      slots[i - 1] = slots[i];
+    }
+    count--;
+  }
+
+  return count == 0;
+}
+
+auto ReportMailbox::isEmpty() const -> bool {
+  return count == 0;
+}
@@ -0,0 +1,41 @@
+#ifndef REPORTMAILBOX_H73150628
+#define REPORTMAILBOX_H73150628
+
+#include <stdint.h>
+
+
+struct MouseReport {
+  uint8_t buttons = 0;
+  int16_t x = 0;
+  int16_t y = 0;
+  int16_t wheel = 0;
+  int16_t pan = 0;
+};
+
+
+// Holds reports the endpoint had no room for, so sending never waits for
+// the host. A new report is merged into the newest waiting one if the
+// buttons match; a button change takes the second slot so the edge still
+// reaches the host.
+class ReportMailbox {
+public:
+  // queues report, merging as much motion as fits. what does not fit in
+  // the report range is left in report for the caller to carry over.
+  // false if it is a button change and both slots are taken: nothing was
+  // queued, publish it again once flush() made room
+  auto publish(MouseReport& report) -> bool;
+
+  // hands up to maxReports waiting reports to the endpoint, stopping early
+  // if it is busy. true if none are left
+  auto flush(uint8_t maxReports = slot_count) -> bool;
+
+  [[nodiscard]] auto isEmpty() const -> bool;
+
+  static constexpr uint8_t slot_count = 2;
+
+private:
+  MouseReport slots[slot_count];
+  uint8_t count = 0;
+};
+
+#endif  // REPORTMAILBOX_H73150628
@@ -0,0 +1,71 @@
+#include "ReportScheduler.h"
+
+
+void ReportScheduler::setPeriod(uint32_t periodMus) {
+  // the pending deadline stays, the new period applies from there
+  this->periodMus = periodMus;
+}
+
+auto ReportScheduler::period() const -> uint32_t {
+  return periodMus;
+}
+
+void ReportScheduler::start(uint32_t nowMus) {
+  nextMus = nowMus;
+}
+
+void ReportScheduler::align(uint32_t gridMus) {
+  if (periodMus == 0) {
+    return;
+  }
+
+  // signed, so it stays right across the micros() wrap
+  int32_t period = static_cast<int32_t>(periodMus);
+  int32_t offsetMus = static_cast<int32_t>(nextMus - gridMus) % period;
+  if (offsetMus < 0) {
+    offsetMus += period;
+  }
+
+  if (offsetMus <= period / 2) {
+    nextMus -= offsetMus;
+  } else {
+    nextMus += period - offsetMus;
+  }
+}
+
+auto ReportScheduler::isDue(uint32_t nowMus) -> bool {
+  uint32_t lateMus = nowMus - nextMus;
+  if (static_cast<int32_t>(lateMus) < 0) {
+    return false;
+  }
+
+  if (periodMus == 0) {
+    nextMus = nowMus;
+    lateMus = 0;
+  } else if (lateMus >= periodMus) {
+    // fell behind by whole periods: drop them but stay on the grid
+    uint32_t missed = lateMus / periodMus;
+    stats_.skipped += missed;
+    lateMus -= missed * periodMus;
+    nextMus += (missed + 1) * periodMus;
+  } else {
+    nextMus += periodMus;
+  }
+
+  stats_.reports++;
+  stats_.lastLateMus = lateMus;
+  stats_.totalLateMus += lateMus;
+  if (lateMus > stats_.maxLateMus) {
+    stats_.maxLateMus = lateMus;
+  }
+
+  return true;
+}
+
+auto ReportScheduler::stats() const -> const ReportTimingStats& {
+  return stats_;
+}
+
+void ReportScheduler::resetStats() {
+  stats_ = {};
+}
@@ -0,0 +1,45 @@
+#ifndef REPORTSCHEDULER_H40917265
+#define REPORTSCHEDULER_H40917265
+
+#include <stdint.h>
+
+
+struct ReportTimingStats {
+  uint32_t reports = 0;
+  uint32_t skipped = 0;       // periods that passed without a report
+  uint32_t lastLateMus = 0;   // how late the last report was
+  uint32_t maxLateMus = 0;
+  uint64_t totalLateMus = 0;
+};
+
+
+// Paces reports on a fixed grid of periodMus. Deadlines advance by exactly
+// one period, so a late report does not shift the ones after it; if the
+// loop falls behind by whole periods they are skipped, not sent in a burst.
+// Times are micros() values and may wrap.
+class ReportScheduler {
+public:
+  // 0 reports on every call
+  void setPeriod(uint32_t periodMus);
+  [[nodiscard]] auto period() const -> uint32_t;
+
+  void start(uint32_t nowMus);
+  // moves the grid to the nearest phase that runs through gridMus, e.g.
+  // to follow an outside clock. the next deadline shifts by at most half
+  // a period
+  void align(uint32_t gridMus);
+
+  // true if a report is due at nowMus. the caller must then send one
+  auto isDue(uint32_t nowMus) -> bool;
+
+  [[nodiscard]] auto stats() const -> const ReportTimingStats&;
+  void resetStats();
+
+private:
+  uint32_t periodMus = 0;
+  uint32_t nextMus = 0;
+
+  ReportTimingStats stats_;
+};
+
+#endif  // REPORTSCHEDULER_H40917265
@@ -1,5 +1,6 @@
 #include <math.h>
 
+#include "Hal.h"
 #include "Trackball.h"
 
 // clang-format off
@@ -100,11 +101,21 @@ static const uint8_t hidReportDescriptor[] PROGMEM = {
 };
 // clang-format on
 
+static constexpr double report_max = 32767.0;
+static constexpr uint32_t idle_unit_mus = 4000;
 
-static auto subtractMaxIntegral(double& value, double scale) -> int16_t {
-  double moveXNowF = 0.0;
-  value = modf(value * scale, &moveXNowF) / scale;
-  return static_cast<int16_t>(moveXNowF);
+
+// whole counts of value that fit in one report field. anything beyond
+// +-32767, and the fraction, stays in value for the next report
+static auto takeReportable(double& value) -> int16_t {
+  double counts = floor(value);
+  if (counts > report_max) {
+    counts = report_max;
+  } else if (counts < -report_max) {
+    counts = -report_max;
+  }
+  value -= counts;
+  return static_cast<int16_t>(counts);
 }
 
 
@@ -129,7 +140,7 @@ void Trackball_t::begin() {
     hidInitialized = true;
   }
 
-  send(micros());
+  send(Hal::micros());
 }
 
 void Trackball_t::end() {
@@ -148,6 +159,11 @@ void Trackball_t::reset() {
   scrollY = 0;
   scrollScaleX = 1.0;
   scrollScaleY = 1.0;
+
+  carryMoveX = 0.0;
+  carryMoveY = 0.0;
+  carryScrollX = 0.0;
+  carryScrollY = 0.0;
 }
 
 auto Trackball_t::buttons() const -> uint8_t {
@@ -181,6 +197,15 @@ void Trackball_t::move(double x, double y) {
   moveY += y;
 }
 
+void Trackball_t::move(double x, double y, uint64_t sinceMus, uint64_t sampleMus) {
+  move(x, y);
+  if (!hasMoveMus) {
+    moveSinceMus = sinceMus;
+  }
+  moveMus = sampleMus;
+  hasMoveMus = true;
+}
+
 void Trackball_t::scroll(double x, double y) {
   scrollX += x;
   scrollY += y;
@@ -260,10 +285,26 @@ void Trackball_t::send(uint64_t timestampMus) {
     | (((effectiveBtnState & (1 << MOUSE_EXTRA1)) != 0)  << buttonMap[MOUSE_EXTRA1])
     | (((effectiveBtnState & (1 << MOUSE_EXTRA2)) != 0)  << buttonMap[MOUSE_EXTRA2]);
 
-  auto moveOff = moveAccel.update(moveX, moveY, timestampMus / 1000);
+  if (!isReportNeeded(sendButtons, timestampMus)) {
+    prevBtnState = btnState;
+    prevScrollButtonsInMode = scrollButtonsInMode;
+    hasMoveMus = false;
+    flush();
+    return;
+  }
+
+  bool isSampled = hasMoveMus;
+  uint64_t motionMus = isSampled ? moveMus : timestampMus;
+  hasMoveMus = false;
+
+  auto moveOff = isSampled
+    ? moveAccel.update(moveX, moveY, moveSinceMus, motionMus)
+    : moveAccel.update(moveX, moveY, motionMus);
 
-  auto moveXNow = static_cast<int16_t>(floor(moveOff.dx * moveScaleX));
-  auto moveYNow = static_cast<int16_t>(floor(moveOff.dy * moveScaleY));
+  carryMoveX += moveOff.dx * moveScaleX;
+  carryMoveY += moveOff.dy * moveScaleY;
+  auto moveXNow = takeReportable(carryMoveX);
+  auto moveYNow = takeReportable(carryMoveY);
 
   moveX = 0.0;
   moveY = 0.0;
@@ -272,32 +313,87 @@ void Trackball_t::send(uint64_t timestampMus) {
   auto scrollOff = scrollAccel.update(
     scrollX,
     scrollY,
-    timestampMus / 1000,
+    motionMus,
     prevScrollButtonsInMode == 0
   );
 
-  auto scrollXNow = static_cast<int16_t>(floor(scrollOff.dx * scrollScaleX));
-  auto scrollYNow = static_cast<int16_t>(-floor(scrollOff.dy * scrollScaleY));
+  carryScrollX += scrollOff.dx * scrollScaleX;
+  carryScrollY += scrollOff.dy * scrollScaleY;
+  auto scrollXNow = takeReportable(carryScrollX);
+  auto scrollYNow = static_cast<int16_t>(-takeReportable(carryScrollY));
 
   scrollX = 0.0;
   scrollY = 0.0;
 
 
-  uint8_t mouseReport[] = {
-    static_cast<uint8_t>(sendButtons & 0xff),
-    static_cast<uint8_t>(moveXNow & 0xFF),
-    static_cast<uint8_t>((moveXNow >> 8) & 0xFF),
-    static_cast<uint8_t>(moveYNow & 0xFF),
-    static_cast<uint8_t>((moveYNow >> 8) & 0xFF),
-    static_cast<uint8_t>(scrollYNow & 0xff),
-    static_cast<uint8_t>((scrollYNow >> 8) & 0xff),
-    static_cast<uint8_t>(scrollXNow & 0xff),
-    static_cast<uint8_t>((scrollXNow >> 8) & 0xff),
-  };
-  HID().SendReport(0x01, mouseReport, sizeof(mouseReport) / sizeof(mouseReport[0]));
+  MouseReport report;
+  report.buttons = sendButtons;
+  report.x = moveXNow;
+  report.y = moveYNow;
+  report.wheel = scrollYNow;
+  report.pan = scrollXNow;
+  uint8_t irqState = Hal::interruptsOff();
+  bool isPublished = mailbox.publish(report);
+  Hal::interruptsRestore(irqState);
+
+  // whatever did not fit in the waiting report goes out with a later one
+  carryMoveX += report.x;
+  carryMoveY += report.y;
+  carryScrollX += report.pan;
+  carryScrollY -= report.wheel;
+
+  // a button change that found the mailbox full stays pending. that
+  // includes the click synthesized for a scroll button released outside
+  // scroll mode, which is derived from the previous state
+  if (isPublished) {
+    sentButtons = sendButtons;
+    sentMus = timestampMus;
+    prevBtnState = btnState;
+    prevScrollButtonsInMode = scrollButtonsInMode;
+  }
+  flush();
+}
+
+void Trackball_t::setFrameSync(bool isEnabled) {
+  isFrameSync = isEnabled;
+}
+
+void Trackball_t::flush() {
+  if (isFrameSync) {
+    return;
+  }
+
+  uint8_t irqState = Hal::interruptsOff();
+  mailbox.flush();
+  Hal::interruptsRestore(irqState);
+}
+
+// one report per frame, and only into an empty endpoint: anything loaded
+// earlier would wait there a whole frame and be stale when polled
+void Trackball_t::loadFrame() {
+  if (!mailbox.isEmpty() && HID().IsEndpointIdle()) {
+    mailbox.flush(1);
+  }
+}
+
+// a report is due on a button change, on movement or carry of at least
+// one count, or when the host's idle period runs out
+auto Trackball_t::isReportNeeded(uint8_t sendButtons, uint64_t timestampMus) const -> bool {
+  if (sendButtons != sentButtons) {
+    return true;
+  }
+
+  if (moveX != 0.0 || moveY != 0.0 || scrollX != 0.0 || scrollY != 0.0) {
+    return true;
+  }
+
+  if (fabs(carryMoveX) >= 1.0 || fabs(carryMoveY) >= 1.0
+      || fabs(carryScrollX) >= 1.0 || fabs(carryScrollY) >= 1.0) {
+    return true;
+  }
 
-  prevBtnState = btnState;
-  prevScrollButtonsInMode = scrollButtonsInMode;
+  uint8_t idleRate = HID().IdleRate();
+  return idleRate != 0 && timestampMus - sentMus >= static_cast<uint64_t>(idleRate) * idle_unit_mus;
 }
 
 // WARN make sure only one instance exists else
@@ -3,6 +3,7 @@
 
 #include "Acceleration.h"
 #include "HID.h"
+#include "ReportMailbox.h"
 
 // order corresponds to HID mouse device button order
 enum MouseButton : uint8_t {
@@ -35,6 +36,9 @@ public:
   void set(uint8_t btnId, bool isDown);
 
   void move(double x, double y);
+  // motion measured over sinceMus..sampleMus. acceleration takes the next
+  // report's speed from when it was sampled instead of when it is sent
+  void move(double x, double y, uint64_t sinceMus, uint64_t sampleMus);
   void scroll(double x, double y);
 
   void setMoveScale(double scaleX, double scaleY);
@@ -42,12 +46,20 @@ public:
 
   void send(uint64_t timestampMus);
 
+  // in frame sync mode send() only composes the report and loadFrame(),
+  // called from an interrupt just before the host polls, loads it
+  void setFrameSync(bool isEnabled);
+  void loadFrame();
+
 private:
   uint8_t btnState = 0b00000000;
   uint8_t prevBtnState = 0b00000000;
   
   double moveX = 0.0;
   double moveY = 0.0;
+  uint64_t moveSinceMus = 0;
+  uint64_t moveMus = 0;
+  bool hasMoveMus = false;
   double moveScaleX = 1.0;
   double moveScaleY = 1.0;
 
@@ -56,6 +68,13 @@ private:
   double scrollScaleX = 1.0;
   double scrollScaleY = 1.0;
 
+  // scaled, accelerated movement not sent yet: beyond the report range or
+  // below one count
+  double carryMoveX = 0.0;
+  double carryMoveY = 0.0;
+  double carryScrollX = 0.0;
+  double carryScrollY = 0.0;
+
   MouseAcceleration moveAccel{1.0, 0.1, 1.0};
   MouseAcceleration scrollAccel;
 
@@ -80,7 +99,18 @@ private:
   uint8_t scrollButtonsInMode = 0b00000000;
   uint8_t prevScrollButtonsInMode = 0b00000000;
 
+  // last report published, to leave out ones that would not change anything
+  uint8_t sentButtons = 0b00000000;
+  uint64_t sentMus = 0;
+
+  // reports waiting for the endpoint. shared with loadFrame()
+  ReportMailbox mailbox;
+  bool isFrameSync = false;
+
+  void flush();
+
   void reset();
+  [[nodiscard]] auto isReportNeeded(uint8_t sendButtons, uint64_t timestampMus) const -> bool;
 };
 
 // singleton
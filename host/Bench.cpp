@@ -0,0 +1,93 @@
+// Runs the sensor driver and trackball pipeline on the host against a
+// canned burst and reports the CPU time spent per frame. Sensor timing
+// runs on the virtual clock, so only the pipeline's own work is measured.
+//
+//   marble_bench [frames]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "HalPosix.h"
+#include "PMW3389.h"
+#include "Trackball.h"
+
+namespace {
+  constexpr uint8_t ncs_pin = 5;
+
+  // answers every motion burst with the same frame and every register
+  // read with zero
+  class CannedBurst : public SpiDevice {
+  public:
+    void select(bool isSelected) override {
+      pos = isSelected ? 0 : -1;
+    }
+
+    auto transfer(uint8_t data) -> uint8_t override {
+      if (pos < 0) {
+        return 0xff;
+      }
+
+      if (pos++ == 0) {
+        address = data;
+        return 0x00;
+      }
+
+      if (address == REG_Motion_Burst && pos - 2 < PMW3389_BURST_FULL) {
+        return frame[pos - 2];
+      }
+      return 0x00;
+    }
+
+  private:
+    int pos = -1;
+    uint8_t address = 0;
+    const uint8_t frame[PMW3389_BURST_FULL] = {
+      0x80, 0x40, 0x07, 0x00, 0xfd, 0xff, 0x40, 0x20, 0x50, 0x10, 0x00, 0x80,
+    };
+  };
+
+  size_t reportCount = 0;
+
+  void countReport(uint16_t /*id*/, const void* /*data*/, int /*len*/, void* /*ctx*/) {
+    reportCount++;
+  }
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  long frames = argc > 1 ? std::atol(argv[1]) : 100000;
+
+  CannedBurst device;
+  HalPosix::useVirtualClock(true);
+  HalPosix::attachSpi(&device, ncs_pin);
+  HID().setReportSink(countReport, nullptr);
+
+  PMW3389 sensor;
+  sensor.begin(ncs_pin, 800);
+  Trackball.begin();
+
+  PMW3389_MOTION motion = {};
+  uint64_t spiStart = HalPosix::spiBytes();
+  auto start = std::chrono::steady_clock::now();
+
+  for (long i = 0; i < frames; i++) {
+    sensor.startBurst();
+    while (!sensor.pollBurst(motion)) {
+    }
+
+    Trackball.move(-motion.dx * 0.1, motion.dy * 0.1);
+    Trackball.send(Hal::micros());
+  }
+
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+  std::printf("frames:          %ld\n", frames);
+  std::printf("reports:         %zu\n", reportCount);
+  std::printf("ns per frame:    %.1f\n", static_cast<double>(ns) / static_cast<double>(frames));
+  std::printf("spi B per frame: %.2f\n",
+    static_cast<double>(HalPosix::spiBytes() - spiStart) / static_cast<double>(frames));
+
+  return 0;
+}
@@ -0,0 +1,175 @@
+// Decodes raw sensor frames from the firmware's config serial stream (see
+// Firmware/FrameStream.h), writes each one as a PGM image and prints
+// statistics that tell a clean, well focused ball from a dirty or worn one.
+//
+//   marble_frames <stream> [outdir]
+//
+// <stream> is a capture file or the serial device itself, e.g. after
+// `stty -F /dev/ttyUSB0 9600 raw`. Anything between frames is ignored.
+// Images are written to outdir (default ".") as frame_<sequence>.pgm.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "FrameStream.h"
+
+namespace {
+  struct FrameStats {
+    double mean = 0.0;
+    int min = 255;
+    int max = 0;
+    double rmsContrast = 0.0;   // stddev / mean
+    double michelson = 0.0;     // (max - min) / (max + min)
+    double focus = 0.0;         // variance of the Laplacian
+  };
+
+  auto computeStats(const std::vector<uint8_t>& pixels, int width, int height) -> FrameStats {
+    FrameStats stats;
+    double sum = 0.0;
+    for (uint8_t p : pixels) {
+      sum += p;
+      stats.min = p < stats.min ? p : stats.min;
+      stats.max = p > stats.max ? p : stats.max;
+    }
+    stats.mean = sum / static_cast<double>(pixels.size());
+
+    double variance = 0.0;
+    for (uint8_t p : pixels) {
+      variance += (p - stats.mean) * (p - stats.mean);
+    }
+    variance /= static_cast<double>(pixels.size());
+
+    stats.rmsContrast = stats.mean > 0.0 ? std::sqrt(variance) / stats.mean : 0.0;
+    stats.michelson = stats.max + stats.min > 0
+      ? static_cast<double>(stats.max - stats.min) / (stats.max + stats.min)
+      : 0.0;
+
+    // a sharp, textured surface has strong local edges; blur and dirt
+    // flatten them
+    std::vector<double> laplacian;
+    for (int y = 1; y < height - 1; y++) {
+      for (int x = 1; x < width - 1; x++) {
+        auto at = [&](int dx, int dy) {
+          return static_cast<double>(pixels[(y + dy) * width + (x + dx)]);
+        };
+        laplacian.push_back(at(-1, 0) + at(1, 0) + at(0, -1) + at(0, 1) - 4.0 * at(0, 0));
+      }
+    }
+
+    double lapMean = 0.0;
+    for (double v : laplacian) {
+      lapMean += v;
+    }
+    lapMean /= laplacian.empty() ? 1.0 : static_cast<double>(laplacian.size());
+
+    for (double v : laplacian) {
+      stats.focus += (v - lapMean) * (v - lapMean);
+    }
+    stats.focus /= laplacian.empty() ? 1.0 : static_cast<double>(laplacian.size());
+
+    return stats;
+  }
+
+  auto writePgm(const std::string& path, const std::vector<uint8_t>& pixels, int width, int height) -> bool {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+      return false;
+    }
+
+    // raw data is 7 bit
+    std::fprintf(file, "P5\n%d %d\n127\n", width, height);
+    std::fwrite(pixels.data(), 1, pixels.size(), file);
+    std::fclose(file);
+    return true;
+  }
+
+  auto readExact(FILE* file, void* buf, size_t len) -> bool {
+    return std::fread(buf, 1, len, file) == len;
+  }
+
+  // scan forward to the next magic, leaving the header's first bytes in place
+  auto findMagic(FILE* file, FrameStreamHeader& header) -> bool {
+    size_t matched = 0;
+    int c = 0;
+    while ((c = std::fgetc(file)) != EOF) {
+      if (static_cast<uint8_t>(c) == frameStreamMagic[matched]) {
+        header.magic[matched++] = static_cast<uint8_t>(c);
+        if (matched == sizeof(frameStreamMagic)) {
+          return true;
+        }
+      } else {
+        matched = static_cast<uint8_t>(c) == frameStreamMagic[0] ? 1 : 0;
+        header.magic[0] = frameStreamMagic[0];
+      }
+    }
+    return false;
+  }
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: %s <stream> [outdir]\n", argv[0]);
+    return 2;
+  }
+  std::string outDir = argc > 2 ? argv[2] : ".";
+
+  FILE* stream = std::fopen(argv[1], "rb");
+  if (stream == nullptr) {
+    std::fprintf(stderr, "cannot open %s\n", argv[1]);
+    return 2;
+  }
+
+  size_t frameCount = 0;
+  size_t badCount = 0;
+
+  FrameStreamHeader header = {};
+  while (findMagic(stream, header)) {
+    auto* rest = reinterpret_cast<uint8_t*>(&header) + sizeof(header.magic);
+    if (!readExact(stream, rest, sizeof(header) - sizeof(header.magic))) {
+      break;
+    }
+
+    if (header.version != frameStreamVersion || header.length != header.width * header.height) {
+      std::fprintf(stderr, "skipping frame with bad header\n");
+      badCount++;
+      continue;
+    }
+
+    std::vector<uint8_t> pixels(header.length);
+    uint8_t trailer[2];
+    if (!readExact(stream, pixels.data(), pixels.size()) || !readExact(stream, trailer, sizeof(trailer))) {
+      break;
+    }
+
+    uint16_t checksum = frameStreamChecksum(0, reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+    checksum = frameStreamChecksum(checksum, pixels.data(), pixels.size());
+    if (checksum != (trailer[0] | trailer[1] << 8)) {
+      std::fprintf(stderr, "frame %u: checksum mismatch, skipped\n", header.sequence);
+      badCount++;
+      continue;
+    }
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "/frame_%05u.pgm", header.sequence);
+    std::string path = outDir + name;
+    if (!writePgm(path, pixels, header.width, header.height)) {
+      std::fprintf(stderr, "cannot write %s\n", path.c_str());
+      return 2;
+    }
+
+    FrameStats stats = computeStats(pixels, header.width, header.height);
+    std::printf(
+      "%s: squal %u, shutter %u, mean %.1f, range %d-%d, rms contrast %.3f, michelson %.3f, focus %.1f\n",
+      path.c_str(), header.squal, header.shutter, stats.mean, stats.min, stats.max,
+      stats.rmsContrast, stats.michelson, stats.focus);
+    frameCount++;
+  }
+
+  std::fclose(stream);
+  std::printf("frames: %zu, bad: %zu\n", frameCount, badCount);
+  return badCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+#include <chrono>
+#include <thread>
+
+#include "HalPosix.h"
+
+namespace {
+  constexpr size_t pin_count = 32;
+
+  bool isClockVirtual = false;
+  uint32_t virtualTickMus = 1;
+  uint64_t virtualNowMus = 0;
+
+  const auto clockStart = std::chrono::steady_clock::now();
+
+  uint8_t pinLevels[pin_count] = {};
+
+  SpiDevice* spiDevice = nullptr;
+  uint8_t spiCsPin = 0xff;
+  bool isSpiSelected = false;
+  uint64_t spiByteCount = 0;
+
+  auto nowMus() -> uint64_t {
+    if (isClockVirtual) {
+      return virtualNowMus;
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - clockStart;
+    return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+  }
+}  // namespace
+
+
+auto Hal::micros() -> uint32_t {
+  auto now = static_cast<uint32_t>(nowMus());
+  if (isClockVirtual) {
+    // busy-wait loops on micros() must make progress
+    virtualNowMus += virtualTickMus;
+  }
+  return now;
+}
+
+auto Hal::millis() -> uint32_t {
+  return static_cast<uint32_t>(nowMus() / 1000);
+}
+
+void Hal::delayMicros(unsigned int us) {
+  if (isClockVirtual) {
+    virtualNowMus += us;
+    return;
+  }
+
+  auto until = nowMus() + us;
+  while (nowMus() < until) {
+  }
+}
+
+void Hal::delayMillis(uint32_t ms) {
+  for (uint32_t i = 0; i < ms; i++) {
+    delayMicros(1000);
+  }
+}
+
+void Hal::pinOutput(uint8_t /*pin*/) {
+}
+
+void Hal::pinInputPullup(uint8_t pin) {
+  if (pin < pin_count) {
+    pinLevels[pin] = HIGH;
+  }
+}
+
+void Hal::pinWrite(uint8_t pin, uint8_t level) {
+  if (pin < pin_count) {
+    pinLevels[pin] = level;
+  }
+
+  if (pin == spiCsPin && spiDevice != nullptr) {
+    bool isSelected = level == LOW;
+    if (isSelected != isSpiSelected) {
+      isSpiSelected = isSelected;
+      spiDevice->select(isSelected);
+    }
+  }
+}
+
+auto Hal::pinRead(uint8_t pin) -> uint8_t {
+  return pin < pin_count ? pinLevels[pin] : LOW;
+}
+
+void Hal::spiBegin() {
+}
+
+void Hal::spiBeginTransaction(uint32_t /*clockHz*/) {
+}
+
+void Hal::spiEndTransaction() {
+}
+
+auto Hal::spiTransfer(uint8_t data) -> uint8_t {
+  spiByteCount++;
+  if (spiDevice == nullptr || !isSpiSelected) {
+    return 0xff;
+  }
+  return spiDevice->transfer(data);
+}
+
+void Hal::spiTransfer(void* buf, size_t len) {
+  auto* bytes = static_cast<uint8_t*>(buf);
+  for (size_t i = 0; i < len; i++) {
+    bytes[i] = spiTransfer(bytes[i]);
+  }
+}
+
+
+void HalPosix::useVirtualClock(bool isVirtual, uint32_t tickMus) {
+  virtualNowMus = nowMus();
+  isClockVirtual = isVirtual;
+  virtualTickMus = tickMus;
+}
+
+void HalPosix::advanceMicros(uint32_t us) {
+  if (isClockVirtual) {
+    virtualNowMus += us;
+  } else {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+  }
+}
+
+auto HalPosix::nowMicros() -> uint32_t {
+  return static_cast<uint32_t>(nowMus());
+}
+
+void HalPosix::attachSpi(SpiDevice* device, uint8_t csPin) {
+  spiDevice = device;
+  spiCsPin = csPin;
+  isSpiSelected = false;
+}
+
+void HalPosix::setPin(uint8_t pin, uint8_t level) {
+  if (pin < pin_count) {
+    pinLevels[pin] = level;
+  }
+}
+
+auto HalPosix::spiBytes() -> uint64_t {
+  return spiByteCount;
+}
@@ -0,0 +1,108 @@
+#ifndef HALPOSIX_H30487716
+#define HALPOSIX_H30487716
+
+// POSIX backend for Hal.h. Builds the firmware's sensor driver and
+// trackball pipeline natively so they can be benchmarked and profiled.
+//
+// The clock is either the host's monotonic clock or a virtual clock that
+// only moves when the code under test waits, which makes runs
+// deterministic and skips the datasheet delays. SPI transfers go to
+// whatever SpiDevice is attached; pins are plain memory.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <type_traits>
+
+// Arduino compatibility for code shared with the firmware
+typedef uint8_t byte;
+
+#define PROGMEM
+#define LOW 0
+#define HIGH 1
+
+template <typename A, typename B>
+constexpr auto min(A a, B b) -> std::common_type_t<A, B> {
+  using T = std::common_type_t<A, B>;
+  return static_cast<T>(a) < static_cast<T>(b) ? a : b;
+}
+
+template <typename A, typename B>
+constexpr auto max(A a, B b) -> std::common_type_t<A, B> {
+  using T = std::common_type_t<A, B>;
+  return static_cast<T>(a) > static_cast<T>(b) ? a : b;
+}
+
+template <typename T, typename L, typename H>
+constexpr auto constrain(T value, L low, H high) -> T {
+  auto lo = static_cast<T>(low);
+  auto hi = static_cast<T>(high);
+  return value < lo ? lo : (value > hi ? hi : value);
+}
+
+
+// a device on the SPI bus, selected by its chip select pin
+class SpiDevice {
+public:
+  virtual ~SpiDevice() = default;
+
+  virtual void select(bool isSelected) = 0;
+  virtual auto transfer(uint8_t data) -> uint8_t = 0;
+};
+
+
+struct Hal {
+  static auto micros() -> uint32_t;
+  static auto millis() -> uint32_t;
+  static void delayMicros(unsigned int us);
+  static void delayMillis(uint32_t ms);
+
+  static void pinOutput(uint8_t pin);
+  static void pinInputPullup(uint8_t pin);
+  static void pinWrite(uint8_t pin, uint8_t level);
+  static auto pinRead(uint8_t pin) -> uint8_t;
+
+  static void spiBegin();
+  static void spiBeginTransaction(uint32_t clockHz);
+  static void spiEndTransaction();
+  static auto spiTransfer(uint8_t data) -> uint8_t;
+  static void spiTransfer(void* buf, size_t len);
+
+  static inline auto flashByte(const uint8_t* addr) -> uint8_t {
+    return *addr;
+  }
+
+  // nothing runs concurrently on the host
+  static inline auto interruptsOff() -> uint8_t {
+    return 0;
+  }
+
+  static inline void interruptsRestore(uint8_t /*state*/) {
+  }
+};
+
+
+// host-side controls that have no firmware equivalent
+namespace HalPosix {
+  // virtual clock: micros() advances by tickMus per call and delays
+  // advance it by their length. off by default (monotonic clock)
+  void useVirtualClock(bool isVirtual, uint32_t tickMus = 1);
+  void advanceMicros(uint32_t us);
+
+  // current time without the tick a Hal::micros() call costs, for models
+  // that timestamp traffic without disturbing the code under test
+  auto nowMicros() -> uint32_t;
+
+  // route SPI traffic to `device` while `csPin` is driven low
+  void attachSpi(SpiDevice* device, uint8_t csPin);
+
+  // drive an input pin from the outside, e.g. buttons or MOT
+  void setPin(uint8_t pin, uint8_t level);
+
+  // number of SPI bytes transferred since start
+  auto spiBytes() -> uint64_t;
+}  // namespace HalPosix
+
+#endif  // HALPOSIX_H30487716
@@ -0,0 +1,100 @@
+#include "HID.h"
+
+HID_& HID()
+{
+    static HID_ obj;
+    return obj;
+}
+
+HID_::HID_(void) : rootNode(NULL), descriptorSize(0),
+                   rootReport(NULL), reportCount(0),
+                   pollInterval(HID_POLL_INTERVAL_MS), idle(0), busy(false),
+                   bootProtocol(false),
+                   sentReports(0), failedReports(0),
+                   sink(NULL), sinkContext(NULL)
+{
+}
+
+int HID_::begin(void)
+{
+    return 0;
+}
+
+void HID_::AppendDescriptor(HIDSubDescriptor *node)
+{
+    if (!rootNode) {
+        rootNode = node;
+    } else {
+        HIDSubDescriptor *current = rootNode;
+        while (current->next) {
+            current = current->next;
+        }
+        current->next = node;
+    }
+    descriptorSize += node->length;
+}
+
+int HID_::SetFeature(uint16_t id, const void* data, int len)
+{
+    for (HIDReport* current = rootReport; current; current = current->next) {
+        if (current->id == id) {
+            return reportCount;
+        }
+    }
+
+    HIDReport* report = new HIDReport(id, data, static_cast<uint8_t>(len));
+    report->next = rootReport;
+    rootReport = report;
+
+    reportCount++;
+    return reportCount;
+}
+
+bool HID_::LockFeature(uint16_t id, bool lock)
+{
+    HIDReport* current = GetFeature(id);
+    if (current) {
+        current->lock = lock;
+        return true;
+    }
+    return false;
+}
+
+HIDReport* HID_::GetFeature(uint16_t id)
+{
+    for (HIDReport* current = rootReport; current; current = current->next) {
+        if (current->id == id) {
+            return current;
+        }
+    }
+    return NULL;
+}
+
+uint16_t HID_::DescriptorSize() const
+{
+    return descriptorSize;
+}
+
+void HID_::setReportSink(ReportSink reportSink, void* context)
+{
+    sink = reportSink;
+    sinkContext = context;
+}
+
+int HID_::SendReport(uint16_t id, const void* data, int len)
+{
+    if (busy) {
+        return 0;
+    }
+    if (sink) {
+        sink(id, data, len, sinkContext);
+    }
+    sentReports++;
+    return len + 1;
+}
+
+void HID_::setPollInterval(uint8_t ms)
+{
+    // nothing to enumerate, the sink takes every report
+    pollInterval = ms == 0 ? 1 : ms;
+}
@@ -0,0 +1,107 @@
+// Brings the sensor driver up against the virtual PMW3389 and replays a
+// motion trace through it, printing every burst the driver receives and a
+// summary of datasheet timing violations. Runs on the virtual clock, so the
+// output is identical from run to run.
+//
+//   marble_replay <trace> [-q]
+//
+// Trace times are in us, relative to the moment the sensor is ready. Exits
+// non-zero if the model saw any violation.
+
+#include <cstdio>
+#include <cstring>
+
+#include "HalPosix.h"
+#include "PMW3389.h"
+#include "VirtualPMW3389.h"
+
+namespace {
+  constexpr uint8_t ncs_pin = 5;
+  constexpr uint8_t mot_pin = 3;
+
+  // stop once the trace is used up and MOT has been idle this long
+  constexpr uint32_t idle_exit_mus = 100000;
+}  // namespace
+
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: %s <trace> [-q]\n", argv[0]);
+    return 2;
+  }
+  bool isQuiet = argc > 2 && std::strcmp(argv[2], "-q") == 0;
+
+  VirtualPMW3389 model;
+  HalPosix::useVirtualClock(true);
+  HalPosix::attachSpi(&model, ncs_pin);
+  model.setMotionPin(mot_pin);
+  model.setViolationLog(stderr);
+
+  size_t burstCount = 0;
+  model.setBurstObserver([&](const uint8_t* bytes, size_t len) {
+    burstCount++;
+    if (isQuiet) {
+      return;
+    }
+    std::printf("%10u burst", static_cast<unsigned>(HalPosix::nowMicros()));
+    for (size_t i = 0; i < len; i++) {
+      std::printf(" %02x", bytes[i]);
+    }
+    std::printf("\n");
+  });
+
+  PMW3389 sensor;
+  sensor.start(ncs_pin, 800);
+  while (!sensor.step()) {
+  }
+
+  const PMW3389_BOOT_TIMING& boot = sensor.bootTiming();
+  std::printf("sensor ready after %u us\n", static_cast<unsigned>(boot.totalMus));
+
+  if (!model.loadTrace(argv[1], HalPosix::nowMicros())) {
+    std::fprintf(stderr, "cannot read trace %s\n", argv[1]);
+    return 2;
+  }
+
+  PMW3389_MOTION motion = {};
+  int32_t sumX = 0;
+  int32_t sumY = 0;
+  uint32_t idleSince = HalPosix::nowMicros();
+
+  for (;;) {
+    model.update();
+
+    if (!sensor.isBurstPending() && Hal::pinRead(mot_pin) == LOW) {
+      sensor.startBurst(true);
+    }
+
+    if (sensor.pollBurst(motion)) {
+      sumX += motion.dx;
+      sumY += motion.dy;
+      idleSince = HalPosix::nowMicros();
+    } else if (model.pendingFrames() == 0 && Hal::pinRead(mot_pin) == HIGH
+        && !sensor.isBurstPending()) {
+      if (HalPosix::nowMicros() - idleSince >= idle_exit_mus) {
+        break;
+      }
+    }
+
+    HalPosix::advanceMicros(100);
+  }
+
+  std::printf("bursts:     %zu\n", burstCount);
+  std::printf("motion:     %d, %d\n", static_cast<int>(sumX), static_cast<int>(sumY));
+  const PMW3389_HEALTH& health = sensor.health();
+  std::printf("discarded:  %u garbage, %u srom lost\n",
+    static_cast<unsigned>(health.garbageFrames), static_cast<unsigned>(health.sromLost));
+  std::printf("violations: %u\n", static_cast<unsigned>(model.totalViolations()));
+  for (uint8_t i = 0; i < VirtualPMW3389::VIOLATION_COUNT; i++) {
+    auto kind = static_cast<VirtualPMW3389::Violation>(i);
+    if (model.violations(kind) > 0) {
+      std::printf("  %-14s %u\n", VirtualPMW3389::violationName(kind),
+        static_cast<unsigned>(model.violations(kind)));
+    }
+  }
+
+  return model.totalViolations() == 0 ? 0 : 1;
+}
@@ -0,0 +1,569 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "PMW3389.h"
+#include "VirtualPMW3389.h"
+
+namespace {
+  // datasheet minimums, in us. kept separate from the driver's copies on
+  // purpose: the model checks the driver, not the other way around
+  constexpr uint32_t t_sww = 180;
+  constexpr uint32_t t_swr = 180;
+  constexpr uint32_t t_srw = 20;
+  constexpr uint32_t t_srr = 20;
+  constexpr uint32_t t_srad = 160;
+  constexpr uint32_t t_srad_motbr = 35;
+  constexpr uint32_t t_sclk_ncs_write = 35;
+  constexpr uint32_t t_load = 15;
+  constexpr uint32_t t_srom_exit = 200;
+  constexpr uint32_t t_power_up = 50000;
+  constexpr uint32_t t_srom_init = 10000;
+  constexpr uint32_t t_srom_crc = 10000;
+
+  constexpr size_t srom_length = 4094;
+  constexpr size_t frame_side = 36;
+  constexpr size_t frame_pixels = frame_side * frame_side;
+
+  constexpr uint8_t observation_srom_run = 0x40;
+
+  auto clamp16(int32_t value) -> int16_t {
+    if (value > INT16_MAX) {
+      return INT16_MAX;
+    }
+    if (value < INT16_MIN) {
+      return INT16_MIN;
+    }
+    return static_cast<int16_t>(value);
+  }
+}  // namespace
+
+
+VirtualPMW3389::VirtualPMW3389() {
+  powerOn();
+}
+
+void VirtualPMW3389::powerOn() {
+  memset(regs, 0, sizeof(regs));
+  regs[REG_Product_ID] = 0x42;
+  regs[REG_Revision_ID] = 0x01;
+  regs[REG_Inverse_Product_ID] = 0xBD;
+  regs[REG_Config1] = 0x31;
+  regs[REG_Config2] = 0x20;
+  regs[REG_Run_Downshift] = 0x32;
+  regs[REG_Rest1_Rate_Lower] = 0x01;
+  regs[REG_Rest1_Downshift] = 0x1F;
+  regs[REG_Rest2_Rate_Lower] = 0x64;
+  regs[REG_Rest2_Downshift] = 0x5E;
+  regs[REG_Rest3_Rate_Lower] = 0xF4;
+  regs[REG_Rest3_Rate_Upper] = 0x01;
+  regs[REG_Min_SQ_Run] = 0x10;
+  regs[REG_Raw_Data_Threshold] = 0x0A;
+  regs[REG_Config5] = 0x31;
+  regs[REG_Lift_Config] = 0x02;
+
+  isInBurst = false;
+  isSromRunning_ = false;
+  isSromArmed = false;
+  sromCount = 0;
+  hasSromLoadEnded = false;
+  hasReset = false;
+  frameCaptureStage = 0;
+  isRawArmed = false;
+
+  accumX = 0;
+  accumY = 0;
+  hasMotion = false;
+}
+
+void VirtualPMW3389::setMotionPin(uint8_t pin) {
+  motionPin = pin;
+  HalPosix::setPin(motionPin, HIGH);
+}
+
+void VirtualPMW3389::pushFrame(const Frame& frame) {
+  frames.push_back(frame);
+}
+
+auto VirtualPMW3389::loadTrace(const char* path, uint32_t offsetMus) -> bool {
+  FILE* file = fopen(path, "r");
+  if (file == nullptr) {
+    return false;
+  }
+
+  char line[128];
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+
+    unsigned long atMus = 0;
+    int dx = 0;
+    int dy = 0;
+    unsigned squal = 0x40;
+    int isLifted = 0;
+    int n = sscanf(line, "%lu %d %d %u %d", &atMus, &dx, &dy, &squal, &isLifted);
+    if (n < 3) {
+      fclose(file);
+      return false;
+    }
+
+    Frame frame;
+    frame.atMus = static_cast<uint32_t>(atMus) + offsetMus;
+    frame.dx = clamp16(dx);
+    frame.dy = clamp16(dy);
+    frame.squal = static_cast<uint8_t>(squal);
+    frame.isLifted = isLifted != 0;
+    frames.push_back(frame);
+  }
+
+  fclose(file);
+  return true;
+}
+
+auto VirtualPMW3389::pendingFrames() const -> size_t {
+  return frames.size() - nextFrame;
+}
+
+void VirtualPMW3389::update() {
+  uint32_t now = HalPosix::nowMicros();
+
+  // navigation only runs with the SROM loaded and outside frame capture
+  bool isNavigating = isSromRunning_ && !isRawArmed;
+
+  while (nextFrame < frames.size() && frames[nextFrame].atMus <= now) {
+    const Frame& frame = frames[nextFrame++];
+    if (isNavigating) {
+      accumX += frame.dx;
+      accumY += frame.dy;
+      current = frame;
+    }
+  }
+
+  hasMotion = isNavigating && (accumX != 0 || accumY != 0);
+
+  if (motionPin != 0xff) {
+    HalPosix::setPin(motionPin, hasMotion ? LOW : HIGH);
+  }
+}
+
+void VirtualPMW3389::setViolationLog(FILE* log) {
+  violationLog = log;
+}
+
+void VirtualPMW3389::setBurstObserver(BurstObserver observer) {
+  burstObserver = std::move(observer);
+}
+
+auto VirtualPMW3389::violations(Violation kind) const -> uint32_t {
+  return kind < VIOLATION_COUNT ? violationCounts[kind] : 0;
+}
+
+auto VirtualPMW3389::totalViolations() const -> uint32_t {
+  uint32_t total = 0;
+  for (uint32_t count : violationCounts) {
+    total += count;
+  }
+  return total;
+}
+
+auto VirtualPMW3389::violationName(Violation kind) -> const char* {
+  switch (kind) {
+  case TIMING_SRAD:
+    return "tSRAD";
+  case TIMING_SRAD_MOTBR:
+    return "tSRAD_MOTBR";
+  case TIMING_SWW:
+    return "tSWW";
+  case TIMING_SWR:
+    return "tSWR";
+  case TIMING_SRW:
+    return "tSRW";
+  case TIMING_SRR:
+    return "tSRR";
+  case TIMING_SCLK_NCS:
+    return "tSCLK-NCS";
+  case TIMING_LOAD:
+    return "tLOAD";
+  case TIMING_SROM_EXIT:
+    return "SROM exit";
+  case TIMING_POWER_UP:
+    return "power up";
+  case TIMING_SROM_INIT:
+    return "SROM init";
+  case TIMING_SROM_CRC:
+    return "SROM CRC";
+  case PROTOCOL_NCS:
+    return "NCS";
+  case PROTOCOL_BURST:
+    return "burst mode";
+  case PROTOCOL_SROM:
+    return "SROM download";
+  default:
+    return "?";
+  }
+}
+
+auto VirtualPMW3389::reg(uint8_t addr) const -> uint8_t {
+  return regs[addr & 0x7f];
+}
+
+auto VirtualPMW3389::isSromRunning() const -> bool {
+  return isSromRunning_;
+}
+
+auto VirtualPMW3389::sromBytes() const -> size_t {
+  return sromCount;
+}
+
+
+void VirtualPMW3389::select(bool isNowSelected) {
+  uint32_t now = HalPosix::nowMicros();
+  update();
+
+  if (isNowSelected) {
+    isSelected = true;
+    op = OP_NONE;
+    pos = 0;
+    return;
+  }
+
+  switch (op) {
+  case OP_NONE:
+    break;
+
+  case OP_READ:
+    if (pos < 2) {
+      flag(PROTOCOL_NCS, now, 0, 0);
+    }
+    lastOp = OP_READ;
+    lastOpEndMus = lastByteAtMus;
+    break;
+
+  case OP_WRITE:
+    if (pos < 2) {
+      flag(PROTOCOL_NCS, now, 0, 0);
+    } else if (now - lastByteAtMus < t_sclk_ncs_write) {
+      flag(TIMING_SCLK_NCS, now, t_sclk_ncs_write, now - lastByteAtMus);
+    }
+    lastOp = OP_WRITE;
+    lastOpEndMus = lastByteAtMus;
+    break;
+
+  case OP_BURST:
+    if (burstObserver) {
+      burstObserver(burstBytes.data(), burstBytes.size());
+    }
+    lastOp = OP_BURST;
+    lastOpEndMus = lastByteAtMus;
+    break;
+
+  case OP_SROM_LOAD:
+    if (sromCount == srom_length) {
+      isSromRunning_ = true;
+      regs[REG_SROM_ID] = 0x04;
+    } else {
+      flag(PROTOCOL_SROM, now, srom_length, static_cast<uint32_t>(sromCount));
+    }
+    isSromArmed = false;
+    hasSromLoadEnded = true;
+    sromLoadEndMus = lastByteAtMus;
+    lastOp = OP_WRITE;
+    lastOpEndMus = lastByteAtMus;
+    break;
+
+  case OP_RAW_BURST:
+    lastOp = OP_READ;
+    lastOpEndMus = lastByteAtMus;
+    break;
+  }
+
+  isSelected = false;
+  op = OP_NONE;
+}
+
+auto VirtualPMW3389::transfer(uint8_t data) -> uint8_t {
+  uint32_t now = HalPosix::nowMicros();
+
+  if (!isSelected) {
+    return 0xff;
+  }
+
+  if (pos == 0) {
+    beginAccess(data, now);
+    addressAtMus = now;
+    lastByteAtMus = now;
+    pos = 1;
+    return 0x00;
+  }
+
+  size_t index = pos - 1;
+  uint8_t out = 0x00;
+
+  switch (op) {
+  case OP_NONE:
+    break;
+
+  case OP_READ:
+    if (index == 0) {
+      if (now - addressAtMus < t_srad) {
+        flag(TIMING_SRAD, now, t_srad, now - addressAtMus);
+      }
+      out = readReg(address, now);
+    }
+    break;
+
+  case OP_WRITE:
+    if (index == 0) {
+      writeReg(address, data, now);
+    }
+    break;
+
+  case OP_BURST:
+    if (index == 0 && now - addressAtMus < t_srad_motbr) {
+      flag(TIMING_SRAD_MOTBR, now, t_srad_motbr, now - addressAtMus);
+    }
+    out = index < sizeof(burst) ? burst[index] : 0x00;
+    burstBytes.push_back(out);
+    break;
+
+  case OP_SROM_LOAD:
+    if (now - lastByteAtMus < t_load) {
+      flag(TIMING_LOAD, now, t_load, now - lastByteAtMus);
+    }
+    sromCount++;
+    break;
+
+  case OP_RAW_BURST:
+    if (index == 0 && now - addressAtMus < t_srad) {
+      flag(TIMING_SRAD, now, t_srad, now - addressAtMus);
+    } else if (index > 0 && now - lastByteAtMus < t_load) {
+      flag(TIMING_LOAD, now, t_load, now - lastByteAtMus);
+    }
+    out = index < frame_pixels ? pixel(index) : 0x00;
+    break;
+  }
+
+  pos++;
+  lastByteAtMus = now;
+  return out;
+}
+
+
+void VirtualPMW3389::flag(Violation kind, uint32_t nowMus, uint32_t needMus, uint32_t gotMus) {
+  violationCounts[kind]++;
+
+  if (violationLog != nullptr) {
+    fprintf(
+      violationLog,
+      "[%10u us] %s violated: need %u, got %u\n",
+      static_cast<unsigned>(nowMus),
+      violationName(kind),
+      static_cast<unsigned>(needMus),
+      static_cast<unsigned>(gotMus));
+  }
+}
+
+void VirtualPMW3389::checkGuard(bool isWrite, uint32_t nowMus) {
+  uint32_t elapsed = nowMus - lastOpEndMus;
+
+  if (lastOp == OP_WRITE) {
+    uint32_t need = isWrite ? t_sww : t_swr;
+    if (elapsed < need) {
+      flag(isWrite ? TIMING_SWW : TIMING_SWR, nowMus, need, elapsed);
+    }
+  } else if (lastOp == OP_READ) {
+    uint32_t need = isWrite ? t_srw : t_srr;
+    if (elapsed < need) {
+      flag(isWrite ? TIMING_SRW : TIMING_SRR, nowMus, need, elapsed);
+    }
+  }
+}
+
+void VirtualPMW3389::beginAccess(uint8_t addr, uint32_t nowMus) {
+  bool isWrite = (addr & 0x80) != 0;
+  uint8_t reg = addr & 0x7f;
+
+  if (hasReset && nowMus - resetAtMus < t_power_up) {
+    flag(TIMING_POWER_UP, nowMus, t_power_up, nowMus - resetAtMus);
+  }
+
+  if (hasSromLoadEnded) {
+    if (nowMus - sromLoadEndMus < t_srom_exit) {
+      flag(TIMING_SROM_EXIT, nowMus, t_srom_exit, nowMus - sromLoadEndMus);
+    }
+    hasSromLoadEnded = false;
+  }
+
+  address = reg;
+
+  if (isWrite && reg == REG_SROM_Load_Burst) {
+    checkGuard(true, nowMus);
+    if (!isSromArmed) {
+      flag(PROTOCOL_SROM, nowMus, 0, 0);
+    }
+    sromCount = 0;
+    op = OP_SROM_LOAD;
+    return;
+  }
+
+  if (!isWrite && reg == REG_Motion_Burst) {
+    // only tBEXIT is required between bursts
+    if (lastOp != OP_BURST) {
+      checkGuard(false, nowMus);
+    }
+    if (!isInBurst) {
+      flag(PROTOCOL_BURST, nowMus, 0, 0);
+    }
+    fillBurst();
+    burstBytes.clear();
+    op = OP_BURST;
+    return;
+  }
+
+  if (!isWrite && reg == REG_Raw_Data_Burst && isRawArmed) {
+    checkGuard(false, nowMus);
+    op = OP_RAW_BURST;
+    return;
+  }
+
+  checkGuard(isWrite, nowMus);
+  op = isWrite ? OP_WRITE : OP_READ;
+
+  // any other register access ends burst mode
+  if (!isWrite) {
+    isInBurst = false;
+  }
+}
+
+void VirtualPMW3389::writeReg(uint8_t addr, uint8_t value, uint32_t nowMus) {
+  if (addr == REG_Motion_Burst) {
+    isInBurst = true;
+    return;
+  }
+
+  isInBurst = false;
+
+  switch (addr) {
+  case REG_Product_ID:
+  case REG_Revision_ID:
+  case REG_Inverse_Product_ID:
+  case REG_SROM_ID:
+    // read only
+    break;
+
+  case REG_Power_Up_Reset:
+    if (value == 0x5a) {
+      powerOn();
+      hasReset = true;
+      resetAtMus = nowMus;
+    }
+    break;
+
+  case REG_SROM_Enable:
+    regs[addr] = value;
+    if (value == 0x1d) {
+      sromInitAtMus = nowMus;
+      isSromArmed = false;
+    } else if (value == 0x18) {
+      if (nowMus - sromInitAtMus < t_srom_init) {
+        flag(TIMING_SROM_INIT, nowMus, t_srom_init, nowMus - sromInitAtMus);
+      }
+      isSromArmed = true;
+    } else if (value == 0x15) {
+      crcAtMus = nowMus;
+    }
+    break;
+
+  case REG_Frame_Capture:
+    if (value == 0x83) {
+      frameCaptureStage = 1;
+    } else if (value == 0xc5 && frameCaptureStage == 1) {
+      // navigation stops until the next Power_Up_Reset
+      isRawArmed = true;
+      frameCaptureStage = 0;
+    } else {
+      frameCaptureStage = 0;
+    }
+    break;
+
+  default:
+    regs[addr] = value;
+    break;
+  }
+}
+
+auto VirtualPMW3389::readReg(uint8_t addr, uint32_t nowMus) -> uint8_t {
+  switch (addr) {
+  case REG_Motion:
+    latchMotion();
+    return regs[REG_Motion];
+
+  case REG_Observation:
+    return isSromRunning_ ? observation_srom_run : 0x00;
+
+  case REG_Data_Out_Lower:
+  case REG_Data_Out_Upper:
+    if (regs[REG_SROM_Enable] != 0x15) {
+      return 0x00;
+    }
+    if (nowMus - crcAtMus < t_srom_crc) {
+      flag(TIMING_SROM_CRC, nowMus, t_srom_crc, nowMus - crcAtMus);
+      return 0x00;
+    }
+    if (!isSromRunning_) {
+      return 0x00;
+    }
+    return addr == REG_Data_Out_Lower ? 0xEF : 0xBE;
+
+  default:
+    return regs[addr];
+  }
+}
+
+void VirtualPMW3389::latchMotion() {
+  update();
+
+  int16_t dx = clamp16(accumX);
+  int16_t dy = clamp16(accumY);
+  accumX -= dx;
+  accumY -= dy;
+
+  regs[REG_Motion] = static_cast<uint8_t>(
+    ((dx != 0 || dy != 0) ? 0x80 : 0x00) | (current.isLifted ? 0x08 : 0x00));
+  regs[REG_Delta_X_L] = static_cast<uint8_t>(dx & 0xff);
+  regs[REG_Delta_X_H] = static_cast<uint8_t>((dx >> 8) & 0xff);
+  regs[REG_Delta_Y_L] = static_cast<uint8_t>(dy & 0xff);
+  regs[REG_Delta_Y_H] = static_cast<uint8_t>((dy >> 8) & 0xff);
+  regs[REG_SQUAL] = current.squal;
+  regs[REG_Shutter_Upper] = static_cast<uint8_t>(current.shutter >> 8);
+  regs[REG_Shutter_Lower] = static_cast<uint8_t>(current.shutter & 0xff);
+
+  hasMotion = accumX != 0 || accumY != 0;
+  if (motionPin != 0xff) {
+    HalPosix::setPin(motionPin, hasMotion ? LOW : HIGH);
+  }
+}
+
+void VirtualPMW3389::fillBurst() {
+  latchMotion();
+
+  burst[0] = regs[REG_Motion];
+  burst[1] = isSromRunning_ ? observation_srom_run : 0x00;
+  burst[2] = regs[REG_Delta_X_L];
+  burst[3] = regs[REG_Delta_X_H];
+  burst[4] = regs[REG_Delta_Y_L];
+  burst[5] = regs[REG_Delta_Y_H];
+  burst[6] = regs[REG_SQUAL];
+  burst[7] = static_cast<uint8_t>(current.squal / 2 + 0x10);  // Raw_Data_Sum
+  burst[8] = 0x60;                                             // Maximum_Raw_Data
+  burst[9] = 0x10;                                             // Minimum_Raw_Data
+  burst[10] = regs[REG_Shutter_Upper];
+  burst[11] = regs[REG_Shutter_Lower];
+}
+
+auto VirtualPMW3389::pixel(size_t index) const -> uint8_t {
+  // a fixed texture so captures can be compared byte for byte
+  size_t x = index % frame_side;
+  size_t y = index / frame_side;
+  return static_cast<uint8_t>(0x20 + ((x * 7 + y * 13 + x * y) % 0x40));
+}
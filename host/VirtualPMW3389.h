@@ -0,0 +1,149 @@
+#ifndef VIRTUALPMW3389_H72310945
+#define VIRTUALPMW3389_H72310945
+
+// Software model of a PMW3389 for the host build. Attach it to the SPI bus
+// with HalPosix::attachSpi() and the unmodified driver talks to it instead
+// of a chip.
+//
+// The model implements the register map from PMW3389.h, motion burst
+// semantics, the SROM download and CRC self test, and Frame_Capture. Every
+// access is checked against the datasheet timing; violations are counted
+// and can be logged as they happen. Motion comes from a scripted trace of
+// timestamped frames, so a run on the virtual clock is bit-for-bit
+// reproducible, including the burst bytes the driver receives.
+
+#include <stdio.h>
+
+#include <functional>
+#include <vector>
+
+#include "HalPosix.h"
+
+class VirtualPMW3389 : public SpiDevice {
+public:
+  enum Violation : uint8_t {
+    TIMING_SRAD,        // register read data clocked before tSRAD
+    TIMING_SRAD_MOTBR,  // burst data clocked before tSRAD_MOTBR
+    TIMING_SWW,         // write too soon after a write
+    TIMING_SWR,         // read too soon after a write
+    TIMING_SRW,         // write too soon after a read
+    TIMING_SRR,         // read too soon after a read
+    TIMING_SCLK_NCS,    // NCS raised before tSCLK-NCS after a write
+    TIMING_LOAD,        // SROM or raw data bytes closer than tLOAD
+    TIMING_SROM_EXIT,   // register access too soon after the SROM download
+    TIMING_POWER_UP,    // register access within 50 ms of Power_Up_Reset
+    TIMING_SROM_INIT,   // SROM_Enable 0x18 within 10 ms of 0x1d
+    TIMING_SROM_CRC,    // CRC result read within 10 ms of SROM_Enable 0x15
+    PROTOCOL_NCS,       // NCS raised in the middle of a register access
+    PROTOCOL_BURST,     // Motion_Burst read without entering burst mode
+    PROTOCOL_SROM,      // SROM download with the wrong length or setup
+    VIOLATION_COUNT,
+  };
+
+  // one sensor frame; applied once the clock passes atMus
+  struct Frame {
+    uint32_t atMus = 0;
+    int16_t dx = 0;
+    int16_t dy = 0;
+    uint8_t squal = 0x40;
+    uint16_t shutter = 0x0080;
+    bool isLifted = false;
+  };
+
+  using BurstObserver = std::function<void(const uint8_t* bytes, size_t len)>;
+
+  VirtualPMW3389();
+
+  // as if power had just been applied: registers at reset values, no SROM
+  void powerOn();
+
+  // drive this pin low while motion is pending, like the MOT output
+  void setMotionPin(uint8_t pin);
+
+  void pushFrame(const Frame& frame);
+  // text trace, one frame per line: "<us> <dx> <dy> [squal] [lifted]";
+  // times are shifted by offsetMus
+  auto loadTrace(const char* path, uint32_t offsetMus = 0) -> bool;
+  auto pendingFrames() const -> size_t;
+
+  // apply due frames and update MOT; also done on every SPI access
+  void update();
+
+  void setViolationLog(FILE* log);
+  void setBurstObserver(BurstObserver observer);
+
+  auto violations(Violation kind) const -> uint32_t;
+  auto totalViolations() const -> uint32_t;
+  static auto violationName(Violation kind) -> const char*;
+
+  auto reg(uint8_t addr) const -> uint8_t;
+  auto isSromRunning() const -> bool;
+  auto sromBytes() const -> size_t;
+
+  void select(bool isSelected) override;
+  auto transfer(uint8_t data) -> uint8_t override;
+
+private:
+  enum Op : uint8_t {
+    OP_NONE,
+    OP_READ,
+    OP_WRITE,
+    OP_BURST,
+    OP_SROM_LOAD,
+    OP_RAW_BURST,
+  };
+
+  uint8_t regs[128] = {};
+
+  bool isSelected = false;
+  Op op = OP_NONE;
+  uint8_t address = 0;
+  size_t pos = 0;
+  uint32_t addressAtMus = 0;
+  uint32_t lastByteAtMus = 0;
+
+  Op lastOp = OP_NONE;
+  uint32_t lastOpEndMus = 0;
+
+  bool isInBurst = false;
+  uint8_t burst[12] = {};
+
+  bool isSromRunning_ = false;
+  bool isSromArmed = false;
+  size_t sromCount = 0;
+  uint32_t sromInitAtMus = 0;
+  uint32_t sromLoadEndMus = 0;
+  bool hasSromLoadEnded = false;
+
+  uint32_t resetAtMus = 0;
+  bool hasReset = false;
+  uint32_t crcAtMus = 0;
+
+  uint8_t frameCaptureStage = 0;
+  bool isRawArmed = false;
+
+  int32_t accumX = 0;
+  int32_t accumY = 0;
+  bool hasMotion = false;
+  Frame current;
+  std::vector<Frame> frames;
+  size_t nextFrame = 0;
+
+  uint8_t motionPin = 0xff;
+
+  uint32_t violationCounts[VIOLATION_COUNT] = {};
+  FILE* violationLog = nullptr;
+  BurstObserver burstObserver;
+  std::vector<uint8_t> burstBytes;
+
+  void flag(Violation kind, uint32_t nowMus, uint32_t needMus, uint32_t gotMus);
+  void checkGuard(bool isWrite, uint32_t nowMus);
+  void beginAccess(uint8_t addr, uint32_t nowMus);
+  void writeReg(uint8_t addr, uint8_t value, uint32_t nowMus);
+  auto readReg(uint8_t addr, uint32_t nowMus) -> uint8_t;
+  void latchMotion();
+  void fillBurst();
+  auto pixel(size_t index) const -> uint8_t;
+};
+
+#endif  // VIRTUALPMW3389_H72310945